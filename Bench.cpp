@@ -0,0 +1,589 @@
+﻿#include "NativeExtract.h"
+#include "FbxPatch.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// ============================================================================
+// Bridge benchmark
+// ============================================================================
+//
+// Generates a synthetic scene (source FBX with RizomUV data, target FBX
+// without it, as Blender exports it), then times every stage of a round
+// trip on the SDK-free code paths:
+//
+//   load        map the source, parse the target and plan the patch
+//   extract     scan the source into snapshots (NativeExtract.h)
+//   cache_write encode and write the .dat; "wait" is the time spent blocked
+//               on the writer's flush thread (--sync-writer writes inline)
+//   cache_read  load the cache for the target's meshes (CacheReader.h)
+//   inject      patch the parsed target (FbxPatch.h)
+//   export      write the patched FBX
+//
+// Each stage reports the median time over all rounds, throughput, heap
+// allocations and the process peak working set. Generating a scene raises
+// the peak on its own, so for memory numbers generate first and pass the
+// files with --source/--target. The SDK import/export cost is measured by
+// running ekstraktor/injektor --batch --summary on the same files.
+//
+// Usage: Bench.exe [options] [--json out.json|-]
+//        Bench.exe [options] --generate <source.fbx> [target.fbx]
+//        Bench.exe [options] --source <source.fbx> --target <target.fbx>
+
+// ============================================================================
+// Allocation counting
+// ============================================================================
+
+static std::atomic<uint64_t> gAllocCount(0);
+static std::atomic<uint64_t> gAllocBytes(0);
+
+// The replacement operators go through these out-of-line helpers. Inlined
+// into callers, malloc/free would show through and GCC would report every
+// new/delete pair as mismatched (-Wmismatched-new-delete).
+#ifdef _MSC_VER
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+BENCH_NOINLINE static void* CountedAllocate(size_t size, size_t alignment) {
+    gAllocCount++;
+    gAllocBytes += size;
+    if (alignment == 0) return std::malloc(size ? size : 1);
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    return std::aligned_alloc(alignment, (size + alignment) / alignment * alignment);
+#endif
+}
+
+BENCH_NOINLINE static void CountedFree(void* ptr, bool aligned) {
+#ifdef _WIN32
+    if (aligned) {
+        _aligned_free(ptr);
+        return;
+    }
+#else
+    (void)aligned;
+#endif
+    std::free(ptr);
+}
+
+void* operator new(size_t size) {
+    if (void* ptr = CountedAllocate(size, 0)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { CountedFree(ptr, false); }
+void operator delete(void* ptr, size_t) noexcept { CountedFree(ptr, false); }
+
+// Over-aligned requests, e.g. the chunks of the cache arena.
+void* operator new(size_t size, std::align_val_t align) {
+    if (void* ptr = CountedAllocate(size, static_cast<size_t>(align))) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept { CountedFree(ptr, true); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { CountedFree(ptr, true); }
+
+double PeakMemoryMB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0.0;
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+// ============================================================================
+// Synthetic scenes
+// ============================================================================
+
+struct BenchConfig {
+    int meshCount = 200;
+    int polygonCount = 5000;
+    int islandCount = 20;
+    size_t blobBytes = 64 * 1024;
+    uint32_t fbxVersion = 7400;
+    unsigned threadCount = 1;
+    bool compactIds = false;
+    bool syncWriter = false;
+    int rounds = 5;
+};
+
+FbxNodeRecord BenchNode(const char* name, FbxPropertyBuilder& props) {
+    FbxNodeRecord node;
+    node.name = name;
+    node.SetProperties(std::move(props.data), props.count);
+    return node;
+}
+
+FbxNodeRecord& BenchChild(FbxNodeRecord& parent, const char* name, FbxPropertyBuilder& props) {
+    FbxNodeRecord& child = parent.AddChild(name);
+    child.SetProperties(std::move(props.data), props.count);
+    return child;
+}
+
+std::string ObjectName(const std::string& name, const char* objectClass) {
+    return name + std::string("\x00\x01", 2) + objectClass;
+}
+
+std::string MakeBlob(size_t size, uint32_t seed) {
+    std::string blob(size, '\0');
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        blob[i] = static_cast<char>(seed >> 24);
+    }
+    return blob;
+}
+
+void AddProperty(FbxNodeRecord& properties70, const char* name, const char* type, const char* label,
+    const std::string* blob, const std::string* str, int32_t intValue) {
+    FbxPropertyBuilder props;
+    props.AddString(name, std::strlen(name));
+    props.AddString(type, std::strlen(type));
+    props.AddString(label, std::strlen(label));
+    props.AddString("U", 1);
+    if (blob) props.AddInt(static_cast<int32_t>(blob->size()));
+    else if (str) props.AddString(*str);
+    else props.AddInt(intValue);
+    FbxNodeRecord& p = BenchChild(properties70, "P", props);
+    if (blob) {
+        FbxPropertyBuilder data;
+        data.AddRaw(blob->data(), blob->size());
+        BenchChild(p, "BinaryData", data);
+    }
+}
+
+// withRizomData = false gives the target: same meshes, no RizomUV data.
+void GenerateScene(const BenchConfig& config, bool withRizomData, FbxBinaryDocument& fbx) {
+    fbx.Reset(config.fbxVersion);
+
+    FbxPropertyBuilder none;
+    fbx.nodes.push_back(BenchNode("FBXHeaderExtension", none));
+    AddIntChild(fbx.nodes.back(), "FBXHeaderVersion", 1003);
+    AddIntChild(fbx.nodes.back(), "FBXVersion", static_cast<int32_t>(config.fbxVersion));
+
+    fbx.nodes.push_back(BenchNode("Documents", none));
+    AddIntChild(fbx.nodes.back(), "Count", 1);
+    FbxPropertyBuilder documentProps;
+    documentProps.AddLong(999);
+    documentProps.AddString(withRizomData ? "Scene" : "");
+    documentProps.AddString("Scene");
+    FbxNodeRecord& document = BenchChild(fbx.nodes.back(), "Document", documentProps);
+    FbxNodeRecord& documentProperties = document.AddChild("Properties70");
+    if (withRizomData) {
+        std::string scene = MakeBlob(config.blobBytes, 1), rootGroup = MakeBlob(config.blobBytes, 2);
+        std::string uvSets = "UVSets", uvMap = "UVMap";
+        AddProperty(documentProperties, "RizomUV", "int", "Integer", nullptr, nullptr, 1);
+        AddProperty(documentProperties, "RizomUV|Scene", "Blob", "", &scene, nullptr, 0);
+        AddProperty(documentProperties, "RizomUV|UVSets", "KString", "", nullptr, &uvSets, 0);
+        AddProperty(documentProperties, "RizomUV|UVSets|UVMap", "KString", "", nullptr, &uvMap, 0);
+        AddProperty(documentProperties, "RizomUV|UVSets|UVMap|RootGroup", "Blob", "", &rootGroup, nullptr, 0);
+    }
+
+    fbx.nodes.push_back(BenchNode("Objects", none));
+    FbxNodeRecord* objects = &fbx.nodes.back();
+    std::vector<std::pair<int64_t, int64_t>> links;
+
+    // Triangle fan strips: polygonCount triangles over polygonCount + 2 vertices.
+    std::vector<double> vertices((config.polygonCount + 2) * 3);
+    for (size_t i = 0; i < vertices.size(); i++) vertices[i] = static_cast<double>(i % 97) * 0.01;
+    std::vector<int32_t> polygons;
+    polygons.reserve(config.polygonCount * 3);
+    for (int p = 0; p < config.polygonCount; p++) {
+        polygons.push_back(p);
+        polygons.push_back(p + 1);
+        polygons.push_back(~(p + 2));
+    }
+    int islandSize = std::max(1, config.polygonCount / std::max(1, config.islandCount));
+    std::vector<int32_t> islands(config.polygonCount);
+    for (int p = 0; p < config.polygonCount; p++) islands[p] = p / islandSize;
+
+    for (int m = 0; m < config.meshCount; m++) {
+        int64_t geometryId = 1000000 + m, modelId = 2000000 + m;
+        std::string name = "SM_Bench_" + std::to_string(m);
+
+        FbxPropertyBuilder geometryProps;
+        geometryProps.AddLong(geometryId);
+        geometryProps.AddString(ObjectName(name + "_Mesh", "Geometry"));
+        geometryProps.AddString("Mesh");
+        FbxNodeRecord& geometry = BenchChild(*objects, "Geometry", geometryProps);
+        FbxNodeRecord& geometryProperties = geometry.AddChild("Properties70");
+        if (withRizomData) {
+            std::string uvSets = "UVMap";
+            AddProperty(geometryProperties, "RizomUVUVSets", "KString", "", nullptr, &uvSets, 0);
+        }
+        FbxPropertyBuilder vertexProps, polygonProps;
+        vertexProps.AddDoubleArray(vertices.data(), vertices.size());
+        polygonProps.AddIntArray(polygons.data(), polygons.size());
+        BenchChild(geometry, "Vertices", vertexProps);
+        BenchChild(geometry, "PolygonVertexIndex", polygonProps);
+        AddIntChild(geometry, "GeometryVersion", 124);
+
+        if (withRizomData) {
+            FbxPropertyBuilder elementProps, idProps;
+            elementProps.AddInt(0);
+            FbxNodeRecord& userData = BenchChild(geometry, "LayerElementUserData", elementProps);
+            AddIntChild(userData, "Version", 101);
+            AddStringChild(userData, "Name", "RizomUVIslandGroupIDs");
+            AddStringChild(userData, "MappingInformationType", "ByPolygon");
+            AddStringChild(userData, "ReferenceInformationType", "Direct");
+            FbxNodeRecord& array = userData.AddChild("UserDataArray");
+            AddStringChild(array, "UserDataType", "Integer");
+            AddStringChild(array, "UserDataName", "IslandGroupID");
+            idProps.AddIntArray(islands.data(), islands.size());
+            BenchChild(array, "UserData", idProps);
+        }
+        FbxPropertyBuilder layerProps;
+        layerProps.AddInt(0);
+        FbxNodeRecord& layer = BenchChild(geometry, "Layer", layerProps);
+        AddIntChild(layer, "Version", 100);
+        if (withRizomData) {
+            FbxNodeRecord& element = layer.AddChild("LayerElement");
+            AddStringChild(element, "Type", "LayerElementUserData");
+            AddIntChild(element, "TypedIndex", 0);
+        }
+
+        FbxPropertyBuilder modelProps;
+        modelProps.AddLong(modelId);
+        modelProps.AddString(ObjectName(name, "Model"));
+        modelProps.AddString("Mesh");
+        FbxNodeRecord& model = BenchChild(*objects, "Model", modelProps);
+        AddIntChild(model, "Version", 232);
+        model.AddChild("Properties70");
+
+        links.push_back({ geometryId, modelId });
+        links.push_back({ modelId, 0 });
+    }
+
+    fbx.nodes.push_back(BenchNode("Connections", none));
+    for (const auto& link : links) {
+        FbxPropertyBuilder c;
+        c.AddString("OO", 2);
+        c.AddLong(link.first);
+        c.AddLong(link.second);
+        BenchChild(fbx.nodes.back(), "C", c);
+    }
+}
+
+bool WriteScene(const BenchConfig& config, bool withRizomData, const std::string& path) {
+    FbxBinaryDocument fbx;
+    GenerateScene(config, withRizomData, fbx);
+    std::string error;
+    if (!fbx.Write(path, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Stages
+// ============================================================================
+
+struct StageResult {
+    const char* name;
+    std::vector<double> ms;
+    uint64_t bytes = 0;        // processed per round, for throughput
+    uint64_t allocations = 0;  // per round, last round
+    uint64_t allocatedBytes = 0;
+    double peakMB = 0.0;
+    std::vector<double> waitMs;  // blocked on I/O, where a stage reports it
+
+    explicit StageResult(const char* stageName) : name(stageName) {}
+
+    static double Median(std::vector<double> sorted) {
+        std::sort(sorted.begin(), sorted.end());
+        return sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+    }
+    double MedianMs() const { return Median(ms); }
+    double MedianWaitMs() const { return Median(waitMs); }
+    double MBPerSecond() const {
+        double median = MedianMs();
+        return median > 0.0 ? (bytes / (1024.0 * 1024.0)) / (median / 1000.0) : 0.0;
+    }
+};
+
+class StageTimer {
+public:
+    explicit StageTimer(StageResult& stage)
+        : result(stage), allocations(gAllocCount.load()), allocatedBytes(gAllocBytes.load()),
+        start(std::chrono::steady_clock::now()) {}
+
+    ~StageTimer() {
+        result.ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        result.allocations = gAllocCount.load() - allocations;
+        result.allocatedBytes = gAllocBytes.load() - allocatedBytes;
+        result.peakMB = PeakMemoryMB();
+    }
+
+private:
+    StageResult& result;
+    uint64_t allocations;
+    uint64_t allocatedBytes;
+    std::chrono::steady_clock::time_point start;
+};
+
+uint64_t FileSize(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    return in.is_open() ? static_cast<uint64_t>(in.tellg()) : 0;
+}
+
+// Touches every page so load includes reading the file, not just mapping it.
+uint64_t TouchPages(const MappedFile& file) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < file.Size(); i += 4096) sum += static_cast<uint8_t>(file.Data()[i]);
+    return sum;
+}
+
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+bool RunRound(const BenchConfig& config, const std::string& source, const std::string& target,
+    const std::string& cache, const std::string& output, std::vector<StageResult>& stages, std::string& error) {
+    MappedFile sourceFile, targetFile;
+    FbxBinaryDocument fbx;
+    PatchPlan plan;
+    {
+        StageTimer timer(stages[0]);
+        volatile uint64_t touched = 0;
+        if (!sourceFile.Open(source) || !targetFile.Open(target)) {
+            error = "could not open the generated scenes";
+            return false;
+        }
+        touched = TouchPages(sourceFile);
+        (void)touched;
+        if (!fbx.Parse(targetFile, error) || !PlanPatch(fbx, NameFilter(), plan, error)) return false;
+    }
+
+    std::vector<PropertySnapshot> documentProperties;
+    std::vector<MeshSnapshot> meshes;
+    {
+        StageTimer timer(stages[1]);
+        ExtractOptions options;
+        options.threadCount = config.threadCount;
+        if (!ScanNativeScene(sourceFile, options, documentProperties, meshes, error)) return false;
+    }
+
+    {
+        StageTimer timer(stages[2]);
+        CacheWriter writer(!config.syncWriter);
+        if (!writer.Open(cache.c_str())) {
+            error = "could not open " + cache;
+            return false;
+        }
+        WriteDocumentBlock(writer, documentProperties);
+        WriteMeshBlocks(writer, meshes, config.threadCount, config.compactIds);
+        if (!writer.Close()) {
+            error = "could not write " + cache;
+            return false;
+        }
+        stages[2].waitMs.push_back(writer.FlushWaitMs());
+    }
+    meshes.clear();
+
+    LoadedCache loaded;
+    {
+        StageTimer timer(stages[3]);
+        if (!LoadAllDataFromFile(cache, loaded, &plan.sceneMeshNames)) {
+            error = "could not load " + cache;
+            return false;
+        }
+    }
+
+    {
+        StageTimer timer(stages[4]);
+        if (!ApplyPatch(fbx, plan, loaded.documentProperties, loaded.geometryData, InjectOptions(), error)) return false;
+    }
+
+    {
+        StageTimer timer(stages[5]);
+        if (!fbx.Write(output, error)) return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+void WriteJson(std::ostream& out, const BenchConfig& config, const std::vector<StageResult>& stages,
+    uint64_t sourceBytes, uint64_t targetBytes, uint64_t cacheBytes, uint64_t outputBytes) {
+    out << std::fixed << std::setprecision(3);
+    out << "{\n";
+    out << "  \"tool\": \"bench\",\n";
+    out << "  \"config\": { \"meshes\": " << config.meshCount << ", \"polygons\": " << config.polygonCount
+        << ", \"islands\": " << config.islandCount << ", \"blob_bytes\": " << config.blobBytes
+        << ", \"fbx_version\": " << config.fbxVersion << ", \"threads\": " << config.threadCount
+        << ", \"compact_ids\": " << (config.compactIds ? "true" : "false")
+        << ", \"async_writer\": " << (config.syncWriter ? "false" : "true") << ", \"rounds\": " << config.rounds << " },\n";
+    out << "  \"files\": { \"source_bytes\": " << sourceBytes << ", \"target_bytes\": " << targetBytes
+        << ", \"cache_bytes\": " << cacheBytes << ", \"output_bytes\": " << outputBytes << " },\n";
+    out << "  \"stages\": [\n";
+    for (size_t i = 0; i < stages.size(); i++) {
+        const StageResult& stage = stages[i];
+        std::vector<double> sorted = stage.ms;
+        std::sort(sorted.begin(), sorted.end());
+        out << "    { \"name\": \"" << stage.name << "\", \"median_ms\": " << stage.MedianMs()
+            << ", \"min_ms\": " << (sorted.empty() ? 0.0 : sorted.front())
+            << ", \"max_ms\": " << (sorted.empty() ? 0.0 : sorted.back())
+            << ", \"mb_per_s\": " << stage.MBPerSecond() << ", \"wait_ms\": " << stage.MedianWaitMs()
+            << ", \"allocations\": " << stage.allocations << ", \"allocated_bytes\": " << stage.allocatedBytes
+            << ", \"peak_memory_mb\": " << stage.peakMB << " }" << (i + 1 < stages.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    std::string jsonPath, workDir = ".", sourcePath, targetPath;
+    std::vector<std::string> generatePaths;
+    bool keepFiles = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--meshes" && hasValue) config.meshCount = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--polygons" && hasValue) config.polygonCount = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--islands" && hasValue) config.islandCount = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--blob-bytes" && hasValue) config.blobBytes = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--fbx-version" && hasValue) config.fbxVersion = static_cast<uint32_t>(std::atoi(argv[++i]));
+        else if (arg == "--rounds" && hasValue) config.rounds = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--threads" && hasValue) config.threadCount = ThreadCountArg(argv[++i]);
+        else if (arg == "--compact-ids") config.compactIds = true;
+        else if (arg == "--sync-writer") config.syncWriter = true;
+        else if (arg == "--json" && hasValue) jsonPath = argv[++i];
+        else if (arg == "--dir" && hasValue) workDir = argv[++i];
+        else if (arg == "--keep") keepFiles = true;
+        else if (arg == "--source" && hasValue) sourcePath = argv[++i];
+        else if (arg == "--target" && hasValue) targetPath = argv[++i];
+        else if (arg == "--generate" && hasValue) {
+            generatePaths.push_back(argv[++i]);
+            if (i + 1 < argc && argv[i + 1][0] != '-') generatePaths.push_back(argv[++i]);
+        }
+        else {
+            std::cout << "Usage: Bench.exe [options] [--json out.json|-]\n";
+            std::cout << "       Bench.exe [options] --generate <source.fbx> [target.fbx]\n";
+            std::cout << "       Bench.exe [options] --source <source.fbx> --target <target.fbx>\n";
+            std::cout << "  --meshes N        meshes per scene (default 200)\n";
+            std::cout << "  --polygons N      polygons per mesh (default 5000)\n";
+            std::cout << "  --islands N       UV islands per mesh (default 20)\n";
+            std::cout << "  --blob-bytes N    size of the RizomUV Scene/RootGroup blobs (default 65536)\n";
+            std::cout << "  --fbx-version N   7400 (32-bit offsets) or 7500 (default 7400)\n";
+            std::cout << "  --threads N       extraction threads (0 = all cores, default 1)\n";
+            std::cout << "  --compact-ids     run-length encode island IDs\n";
+            std::cout << "  --sync-writer     write the cache on the calling thread, for comparison\n";
+            std::cout << "  --rounds N        timed rounds, the median is reported (default 5)\n";
+            std::cout << "  --dir path        where the scenes and cache are written (default .)\n";
+            std::cout << "  --keep            keep the generated files\n";
+            return 1;
+        }
+    }
+
+    if (!generatePaths.empty()) {
+        if (!WriteScene(config, true, generatePaths[0])) return 1;
+        if (generatePaths.size() > 1 && !WriteScene(config, false, generatePaths[1])) return 1;
+        std::cout << "Generated " << config.meshCount << " meshes x " << config.polygonCount << " polygons" << std::endl;
+        return 0;
+    }
+
+    bool generated = sourcePath.empty() || targetPath.empty();
+    std::string source = generated ? workDir + "/bench_source.fbx" : sourcePath;
+    std::string target = generated ? workDir + "/bench_target.fbx" : targetPath;
+    std::string cache = workDir + "/bench.dat";
+    std::string output = workDir + "/bench_output.fbx";
+    if (generated && (!WriteScene(config, true, source) || !WriteScene(config, false, target))) return 1;
+
+    std::vector<StageResult> stages;
+    for (const char* name : { "load", "extract", "cache_write", "cache_read", "inject", "export" }) {
+        stages.emplace_back(name);
+    }
+
+    NullBuffer nullBuffer;
+    std::streambuf* coutBuffer = std::cout.rdbuf(&nullBuffer);
+    std::string error;
+    bool ok = true;
+    for (int round = 0; round < config.rounds && ok; round++) {
+        ok = RunRound(config, source, target, cache, output, stages, error);
+    }
+    std::cout.rdbuf(coutBuffer);
+    if (!ok) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+
+    uint64_t sourceBytes = FileSize(source), targetBytes = FileSize(target);
+    uint64_t cacheBytes = FileSize(cache), outputBytes = FileSize(output);
+    stages[0].bytes = sourceBytes + targetBytes;
+    stages[1].bytes = sourceBytes;
+    stages[2].bytes = cacheBytes;
+    stages[3].bytes = cacheBytes;
+    stages[4].bytes = targetBytes;
+    stages[5].bytes = outputBytes;
+
+    if (generated) std::cout << "Scene: " << config.meshCount << " meshes x " << config.polygonCount << " polygons, "
+        << config.islandCount << " islands, " << config.blobBytes << " byte blobs, FBX " << config.fbxVersion << "\n";
+    std::cout << std::left << std::setw(14) << "stage" << std::right << std::setw(12) << "median ms"
+        << std::setw(12) << "MB/s" << std::setw(10) << "wait ms" << std::setw(14) << "allocations"
+        << std::setw(14) << "alloc MB" << std::setw(12) << "peak MB" << "\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for (const StageResult& stage : stages) {
+        std::cout << std::left << std::setw(14) << stage.name << std::right << std::setw(12) << stage.MedianMs()
+            << std::setw(12) << stage.MBPerSecond() << std::setw(10) << stage.MedianWaitMs() << std::setw(14) << stage.allocations
+            << std::setw(14) << stage.allocatedBytes / (1024.0 * 1024.0) << std::setw(12) << stage.peakMB << "\n";
+    }
+
+    if (jsonPath == "-") {
+        WriteJson(std::cout, config, stages, sourceBytes, targetBytes, cacheBytes, outputBytes);
+    }
+    else if (!jsonPath.empty()) {
+        std::ofstream json(jsonPath);
+        WriteJson(json, config, stages, sourceBytes, targetBytes, cacheBytes, outputBytes);
+        if (json.fail()) {
+            std::cerr << "Error: could not write " << jsonPath << std::endl;
+            return 1;
+        }
+    }
+
+    if (!keepFiles) {
+        if (generated) {
+            std::remove(source.c_str());
+            std::remove(target.c_str());
+        }
+        std::remove(cache.c_str());
+        std::remove(output.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,237 @@
+﻿#pragma once
+#include <fbxsdk.h>
+#include "BridgeLog.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// Job plumbing shared by the Extractor and the Injector
+// ============================================================================
+//
+// A job is the tool's positional arguments, e.g. <input.fbx> <output.dat>,
+// followed by up to optionalCount optional ones.
+// Both --serve and --batch read jobs as tab-separated lines and run them on
+// an FbxManager that is created once and reused.
+
+typedef std::function<int(FbxManager* manager, const std::vector<std::string>& args,
+    std::string& error)> BridgeJobFn;
+
+inline FbxManager* CreateBridgeManager() {
+    FbxManager* manager = FbxManager::Create();
+    FbxIOSettings* ios = FbxIOSettings::Create(manager, IOSROOT);
+    manager->SetIOSettings(ios);
+    return manager;
+}
+
+inline bool JobArgCountValid(const std::vector<std::string>& args, size_t argCount, size_t optionalCount) {
+    return args.size() >= argCount && args.size() <= argCount + optionalCount;
+}
+
+inline std::vector<std::string> SplitJobLine(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab - start));
+        if (tab == std::string::npos) break;
+        start = tab + 1;
+    }
+    return fields;
+}
+
+// Swallows everything; used to mute per-property logging.
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// ============================================================================
+// Server mode
+// ============================================================================
+//
+// Reads one job per line from stdin:
+//
+//   <arg>\t<arg>...   -> "OK <ms>" or "ERROR <ms> <message>"
+//   quit              -> exits
+//
+// "READY <ms>" is printed once the SDK is initialised. Per-property chatter
+// goes to stderr so stdout carries only the protocol.
+
+inline int RunServer(FbxManager* manager, double initMs, size_t argCount,
+    const char* usage, const BridgeJobFn& job, size_t optionalCount = 0) {
+    std::ostream protocol(std::cout.rdbuf());
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+    protocol << "READY " << initMs << std::endl;
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        if (line == "quit") break;
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> fields = SplitJobLine(line);
+        std::string error;
+        int result = 1;
+        if (!JobArgCountValid(fields, argCount, optionalCount)) {
+            error = std::string("Expected ") + usage;
+        }
+        else {
+            result = job(manager, fields, error);
+        }
+
+        if (result == 0) {
+            protocol << "OK " << ElapsedMs(start) << std::endl;
+        }
+        else {
+            protocol << "ERROR " << ElapsedMs(start) << " " << error << std::endl;
+        }
+    }
+
+    std::cout.rdbuf(protocol.rdbuf());
+    return 0;
+}
+
+// ============================================================================
+// Batch mode
+// ============================================================================
+//
+// Runs every job of a manifest (one tab-separated job per line, '#' starts a
+// comment, "-" reads stdin) on jobCount workers. The FBX SDK does not allow
+// concurrent imports on one FbxManager, so each worker creates one manager
+// and reuses it for all of its jobs, with one FbxScene per job.
+//
+// Per-property logging is muted. A progress line per job goes to stderr and
+// a JSON summary with per-file status and timing goes to summaryPath (or
+// stdout when empty). Returns non-zero if any job failed.
+
+struct BatchResult {
+    std::vector<std::string> args;
+    bool ok = false;
+    double ms = 0.0;
+    std::string error;
+};
+
+inline bool ReadManifest(const std::string& path, std::vector<std::vector<std::string>>& jobs) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (path != "-") {
+        file.open(path);
+        if (!file.is_open()) return false;
+        in = &file;
+    }
+
+    std::string line;
+    while (std::getline(*in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        jobs.push_back(SplitJobLine(line));
+    }
+    return true;
+}
+
+inline int RunBatch(const std::string& manifestPath, unsigned jobCount, const std::string& summaryPath,
+    const char* toolName, size_t argCount, const char* usage, const BridgeJobFn& job,
+    size_t optionalCount = 0) {
+
+    std::vector<std::vector<std::string>> jobs;
+    if (!ReadManifest(manifestPath, jobs)) {
+        std::cerr << "Could not open manifest: " << manifestPath << std::endl;
+        return 1;
+    }
+
+    auto batchStart = std::chrono::steady_clock::now();
+    std::vector<BatchResult> results(jobs.size());
+    std::atomic<size_t> next(0);
+    std::mutex progressMutex;
+    std::vector<double> initMs;
+
+    NullBuffer nullBuffer;
+    std::streambuf* coutBuffer = std::cout.rdbuf(&nullBuffer);
+
+    auto worker = [&](size_t workerIndex) {
+        FbxManager* manager = nullptr;
+        for (size_t i = next++; i < jobs.size(); i = next++) {
+            BatchResult& result = results[i];
+            result.args = jobs[i];
+            auto start = std::chrono::steady_clock::now();
+
+            if (!JobArgCountValid(jobs[i], argCount, optionalCount)) {
+                result.error = std::string("Expected ") + usage;
+            }
+            else {
+                if (!manager) {
+                    auto initStart = std::chrono::steady_clock::now();
+                    manager = CreateBridgeManager();
+                    initMs[workerIndex] = ElapsedMs(initStart);
+                }
+                result.ok = job(manager, jobs[i], result.error) == 0;
+            }
+            result.ms = ElapsedMs(start);
+
+            std::lock_guard<std::mutex> lock(progressMutex);
+            std::cerr << (result.ok ? "OK    " : "ERROR ") << result.ms << " ms  "
+                << (result.args.empty() ? std::string() : result.args[0])
+                << (result.ok ? "" : "  " + result.error) << std::endl;
+        }
+        if (manager) manager->Destroy();
+    };
+
+    jobCount = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(jobCount, jobs.size())));
+    initMs.assign(jobCount, 0.0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < jobCount; t++) workers.emplace_back(worker, t);
+    worker(0);
+    for (std::thread& thread : workers) thread.join();
+
+    std::cout.rdbuf(coutBuffer);
+
+    size_t okCount = 0;
+    for (const BatchResult& result : results) okCount += result.ok ? 1 : 0;
+
+    std::ostringstream json;
+    json << "{\n  \"tool\": " << JsonString(toolName)
+        << ",\n  \"jobs\": " << results.size()
+        << ",\n  \"ok\": " << okCount
+        << ",\n  \"failed\": " << results.size() - okCount
+        << ",\n  \"workers\": " << jobCount
+        << ",\n  \"wall_ms\": " << ElapsedMs(batchStart)
+        << ",\n  \"sdk_init_ms\": [";
+    for (size_t i = 0; i < initMs.size(); i++) json << (i ? ", " : "") << initMs[i];
+    json << "],\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BatchResult& result = results[i];
+        json << (i ? "," : "") << "\n    {\"args\": [";
+        for (size_t a = 0; a < result.args.size(); a++) json << (a ? ", " : "") << JsonString(result.args[a]);
+        json << "], \"ok\": " << (result.ok ? "true" : "false")
+            << ", \"ms\": " << result.ms
+            << ", \"error\": " << JsonString(result.error) << "}";
+    }
+    json << "\n  ]\n}\n";
+
+    if (summaryPath.empty()) {
+        std::cout << json.str();
+    }
+    else {
+        std::ofstream summary(summaryPath);
+        summary << json.str();
+        if (!summary) {
+            std::cerr << "Could not write summary: " << summaryPath << std::endl;
+            return 1;
+        }
+    }
+
+    return okCount == results.size() ? 0 : 1;
+}
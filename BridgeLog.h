@@ -0,0 +1,231 @@
+﻿#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// Logging
+// ============================================================================
+//
+// Three levels, chosen on the command line:
+//
+//   --quiet    errors and the final result only
+//   (default)  one line per phase, with counts
+//   --verbose  also one line per property, record and mesh
+//
+// Per-item lines go through BRIDGE_LOG_ITEM. Building with
+// RIZOM_BRIDGE_ITEM_LOG=0 removes them entirely; otherwise a hidden line
+// costs one branch. Lines end in '\n' rather than std::endl, so stdout is
+// flushed by its buffer, not once per line.
+
+#ifndef RIZOM_BRIDGE_ITEM_LOG
+#define RIZOM_BRIDGE_ITEM_LOG 1
+#endif
+
+enum BridgeVerbosity { kVerbosityQuiet = 0, kVerbosityNormal = 1, kVerbosityVerbose = 2 };
+
+inline int& BridgeVerbosityLevel() {
+    static int level = kVerbosityNormal;
+    return level;
+}
+
+// A worker thread can collect its lines instead of printing them, so that
+// the thread waiting on it prints them in one piece (PendingCache). Errors
+// sent to BridgeErrorStream are collected the same way.
+struct BridgeLogCapture {
+    std::ostringstream log;
+    std::ostringstream errors;
+};
+
+inline BridgeLogCapture*& BridgeThreadCapture() {
+    thread_local BridgeLogCapture* capture = nullptr;
+    return capture;
+}
+
+inline std::ostream& BridgeLogStream() {
+    BridgeLogCapture* capture = BridgeThreadCapture();
+    return capture ? static_cast<std::ostream&>(capture->log) : std::cout;
+}
+
+inline std::ostream& BridgeErrorStream() {
+    BridgeLogCapture* capture = BridgeThreadCapture();
+    return capture ? static_cast<std::ostream&>(capture->errors) : std::cerr;
+}
+
+#define BRIDGE_LOG(message) \
+    do { if (BridgeVerbosityLevel() >= kVerbosityNormal) BridgeLogStream() << message << '\n'; } while (0)
+
+#if RIZOM_BRIDGE_ITEM_LOG
+#define BRIDGE_LOG_ITEM_TO(stream, message) \
+    do { if (BridgeVerbosityLevel() >= kVerbosityVerbose) (stream) << message << '\n'; } while (0)
+#else
+#define BRIDGE_LOG_ITEM_TO(stream, message) do { (void)(stream); } while (0)
+#endif
+
+#define BRIDGE_LOG_ITEM(message) BRIDGE_LOG_ITEM_TO(BridgeLogStream(), message)
+
+inline bool BridgeItemLogEnabled() {
+    return RIZOM_BRIDGE_ITEM_LOG && BridgeVerbosityLevel() >= kVerbosityVerbose;
+}
+
+inline double ElapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline std::string JsonString(const std::string& str) {
+    std::string out = "\"";
+    for (char c : str) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+                out += buf;
+            }
+            else {
+                out += c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+// ============================================================================
+// Phase trace
+// ============================================================================
+//
+// --trace out.json records a ScopedPhase event for every phase (SDK init,
+// import, extraction, cache I/O, injection, export) and every mesh, in the
+// Chrome trace event format: open it in chrome://tracing or Perfetto.
+// Counters (meshes, IDs, bytes) are attached as event args. When tracing is
+// off a ScopedPhase only checks one flag.
+
+class PhaseTrace {
+public:
+    static PhaseTrace& Get() {
+        static PhaseTrace trace;
+        return trace;
+    }
+
+    void Enable(const std::string& tracePath) {
+        path = tracePath;
+        origin = std::chrono::steady_clock::now();
+        enabled = true;
+    }
+
+    bool Enabled() const { return enabled; }
+
+    void Add(const std::string& name, std::chrono::steady_clock::time_point start, double durationUs,
+        const std::string& args) {
+        double startUs = std::chrono::duration<double, std::micro>(start - origin).count();
+        std::lock_guard<std::mutex> lock(mutex);
+        std::thread::id id = std::this_thread::get_id();
+        size_t tid = 0;
+        while (tid < threads.size() && threads[tid] != id) tid++;
+        if (tid == threads.size()) threads.push_back(id);
+
+        char timing[96];
+        std::snprintf(timing, sizeof(timing), "\"ts\": %.1f, \"dur\": %.1f, \"tid\": %zu", startUs, durationUs, tid + 1);
+        events.push_back("{ \"name\": " + JsonString(name) + ", \"ph\": \"X\", \"pid\": 1, " + timing +
+            ", \"args\": { " + args + " } }");
+    }
+
+    // Writes everything recorded so far; a no-op when tracing is off.
+    bool Write() {
+        if (!enabled) return true;
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ofstream out(path);
+        out << "{ \"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        for (size_t i = 0; i < events.size(); i++) {
+            out << "  " << events[i] << (i + 1 < events.size() ? ",\n" : "\n");
+        }
+        out << "] }\n";
+        out.close();
+        if (out.fail()) {
+            std::cerr << "Could not write trace: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    bool enabled = false;
+    std::string path;
+    std::chrono::steady_clock::time_point origin;
+    std::mutex mutex;
+    std::vector<std::thread::id> threads;
+    std::vector<std::string> events;
+};
+
+class ScopedPhase {
+public:
+    explicit ScopedPhase(const char* phaseName) : name(phaseName), active(PhaseTrace::Get().Enabled()) {
+        if (active) start = std::chrono::steady_clock::now();
+    }
+
+    // Per-mesh events carry the mesh name.
+    ScopedPhase(const char* phaseName, const std::string& meshName) : ScopedPhase(phaseName) {
+        if (active) args = "\"mesh\": " + JsonString(meshName);
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+    void Count(const char* counter, uint64_t value) {
+        if (!active) return;
+        if (!args.empty()) args += ", ";
+        args += "\"" + std::string(counter) + "\": " + std::to_string(value);
+    }
+
+    // Ends the phase before the scope does.
+    void Stop() {
+        if (!active) return;
+        active = false;
+        double durationUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        PhaseTrace::Get().Add(name, start, durationUs, args);
+    }
+
+    ~ScopedPhase() { Stop(); }
+
+private:
+    const char* name;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+    std::string args;
+};
+
+// Writes the trace when main returns, whichever way it returns.
+struct PhaseTraceWriter {
+    ~PhaseTraceWriter() { PhaseTrace::Get().Write(); }
+};
+
+// Handles --quiet, --verbose and --trace <path>; i is advanced past a value.
+inline bool ParseBridgeLogFlag(int argc, const char* const* argv, int& i) {
+    std::string arg = argv[i];
+    if (arg == "--quiet") {
+        BridgeVerbosityLevel() = kVerbosityQuiet;
+    }
+    else if (arg == "--verbose") {
+        BridgeVerbosityLevel() = kVerbosityVerbose;
+    }
+    else if (arg == "--trace" && i + 1 < argc) {
+        PhaseTrace::Get().Enable(argv[++i]);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
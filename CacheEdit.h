@@ -0,0 +1,560 @@
+﻿#pragma once
+#include "BridgeLog.h"
+#include "CacheReader.h"
+#include "CacheWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// Cache editing: diff, merge, compact
+// ============================================================================
+//
+// Works on v2+ caches without loading them. Inputs stay memory-mapped and
+// are walked once in name order, as a merge join of their sorted indices;
+// only the records of one name are decoded at a time. Output goes through
+// the CacheWriter buffers, and shared payloads are referenced in the mapped
+// inputs instead of copied. Memory is bounded by the indices and the
+// largest single mesh, not by the size of the caches.
+//
+//   diff     per mesh and per record: added, removed, changed
+//   merge    blocks of a partial cache (e.g. from an --include extraction)
+//            replace the blocks of the same name in a base cache
+//   compact  rewrite one cache
+//   verify   check a cache against its checksums (v6+)
+//
+// Merge and compact renumber the blob table, which drops payloads nothing
+// refers to any more and stores payloads shared across inputs once.
+// With compactIds, raw island IDs and other int user data are run-length
+// encoded where smaller.
+
+// An opened cache: its mapping, the index without the blob table entries,
+// and the blob table.
+struct CacheInput {
+    MappedFile mapping;
+    std::vector<CacheIndexEntry> index;
+    BlobTable blobs;
+    std::vector<uint64_t> blobHashes;
+    bool checksums = false;
+};
+
+inline bool OpenCacheInput(const std::string& path, CacheInput& input, std::string& error) {
+    if (!input.mapping.Open(path)) {
+        error = "could not open " + path;
+        return false;
+    }
+    std::vector<CacheIndexEntry> index;
+    if (!ReadCacheIndex(input.mapping, index, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    input.checksums = HasCacheChecksums(CacheVersion(input.mapping));
+    for (const CacheIndexEntry& entry : index) {
+        if (entry.kind != kIndexBlobs) {
+            input.index.push_back(entry);
+            continue;
+        }
+        CacheCursor block = BlockCursor(input.mapping, entry);
+        while (block.pos < block.end) {
+            CacheRecordHeader header;
+            ByteSpan body, bytes;
+            if (NextCacheRecord(block, input.checksums, header, body) != kRecordOk) {
+                error = path + ": blob table is truncated or corrupt.";
+                return false;
+            }
+            CacheCursor cursor{ body.data, body.data + body.size };
+            if (header.marker != 'B') continue;
+            uint64_t hash = 0;
+            bool hashMatches = false;
+            if (!ReadBlob(cursor, hash, bytes, hashMatches)) {
+                error = path + ": blob table is truncated or corrupt.";
+                return false;
+            }
+            if (!hashMatches) {
+                error = path + ": shared payload " + std::to_string(input.blobs.size()) +
+                    " does not match its hash; the cache is corrupt.";
+                return false;
+            }
+            input.blobs.push_back(bytes);
+            input.blobHashes.push_back(hash);
+        }
+    }
+    return true;
+}
+
+inline std::string SpanString(const ByteSpan& span) {
+    return std::string(span.data, span.size);
+}
+
+inline int CompareSpans(const ByteSpan& a, const ByteSpan& b) {
+    int order = std::memcmp(a.data, b.data, std::min(a.size, b.size));
+    if (order != 0 || a.size == b.size) return order;
+    return a.size < b.size ? -1 : 1;
+}
+
+// End of the run of entries sharing index[first]'s name.
+inline size_t NameGroupEnd(const std::vector<CacheIndexEntry>& index, size_t first) {
+    size_t last = first + 1;
+    while (last < index.size() && CompareSpans(index[last].name, index[first].name) == 0) last++;
+    return last;
+}
+
+// Calls visit(aFirst, aLast, bFirst, bLast) once per name in either index,
+// in name order; one of the two ranges is empty if only one side has it.
+template <typename Visit>
+bool JoinCacheIndices(const std::vector<CacheIndexEntry>& a, const std::vector<CacheIndexEntry>& b, Visit visit) {
+    size_t i = 0, j = 0;
+    while (i < a.size() || j < b.size()) {
+        int order = i == a.size() ? 1 : j == b.size() ? -1 : CompareSpans(a[i].name, b[j].name);
+        size_t iEnd = order <= 0 ? NameGroupEnd(a, i) : i;
+        size_t jEnd = order >= 0 ? NameGroupEnd(b, j) : j;
+        if (!visit(i, iEnd, j, jEnd)) return false;
+        i = iEnd;
+        j = jEnd;
+    }
+    return true;
+}
+
+inline bool HasKind(const std::vector<CacheIndexEntry>& index, size_t first, size_t last, char kind) {
+    for (size_t i = first; i < last; i++) {
+        if (index[i].kind == kind) return true;
+    }
+    return false;
+}
+
+// ============================================================================
+// Copying
+// ============================================================================
+
+struct CacheEditStats {
+    size_t blocksKept = 0;      // from the base (or the only input)
+    size_t blocksReplaced = 0;  // base blocks replaced by partial ones
+    size_t blocksAdded = 0;     // partial blocks with no base counterpart
+    size_t idRecordsCompacted = 0;
+};
+
+// Copies the records of entry into out (inside a block the caller opened),
+// pointing blob references into out's table.
+inline bool CopyCacheRecords(const CacheInput& input, const CacheIndexEntry& entry, CacheWriter& out,
+    bool compactIds, CacheEditStats& stats) {
+    CacheCursor block = BlockCursor(input.mapping, entry);
+    std::string body;
+    while (block.pos < block.end) {
+        CacheRecordHeader header;
+        ByteSpan span;
+        if (NextCacheRecord(block, input.checksums, header, span) != kRecordOk) return false;
+        CacheCursor cursor{ span.data, span.data + span.size };
+
+        if ((header.marker == 'G' || header.marker == 'M') && (header.flags & kRecordFlagBlobRef)) {
+            ByteSpan objectName, propName;
+            PropertyType type;
+            uint32_t blobIndex;
+            if (!ReadString(cursor, objectName) || !ReadString(cursor, propName) ||
+                !ReadPropertyType(cursor, header.flags, type)) return false;
+            size_t prefix = cursor.pos - span.data;
+            if (!cursor.ReadU32(blobIndex) || blobIndex >= input.blobs.size() || cursor.pos != cursor.end) return false;
+            const ByteSpan& blob = input.blobs[blobIndex];
+            body.assign(span.data, prefix);
+            WriteU32(body, out.AddBlob(input.blobHashes[blobIndex], blob.data, blob.size));
+            out.WriteRecord(header.marker, body, header.flags);
+        }
+        else if (header.marker == 'I' && compactIds && !(header.flags & kRecordFlagRleIds)) {
+            ByteSpan meshName, userDataName;
+            IntSpan raw;
+            if (!ReadString(cursor, meshName) || !ReadString(cursor, userDataName) ||
+                !ReadIntArray(cursor, raw)) return false;
+            std::vector<int> ids(raw.count);
+            CopyInts(raw, ids.data());
+            body.assign(span.data, meshName.size + userDataName.size + 2 * sizeof(uint32_t));
+            uint8_t flags = header.flags | WriteIslandIds(body, ids.data(), ids.size(), true);
+            if (flags & kRecordFlagRleIds) stats.idRecordsCompacted++;
+            out.WriteRecord('I', body, flags);
+        }
+        else if (header.marker == 'U' && compactIds && !(header.flags & kRecordFlagRleIds)) {
+            ByteSpan meshName;
+            UserDataArray array;
+            if (!ReadUserDataRecord(cursor, header.flags, meshName, array)) return false;
+            if (array.type != kPropertyInt) {
+                out.WriteRecord('U', span.data, span.size, header.flags);
+                continue;
+            }
+            std::vector<int> values(array.values.count);
+            CopyInts(array.values, values.data());
+            // Everything up to the value count stays as it is.
+            body.assign(span.data, array.values.data - sizeof(uint32_t) - span.data);
+            uint8_t flags = header.flags | WriteIslandIds(body, values.data(), values.size(), true);
+            if (flags & kRecordFlagRleIds) stats.idRecordsCompacted++;
+            out.WriteRecord('U', body, flags);
+        }
+        else {
+            out.WriteRecord(header.marker, span.data, span.size, header.flags);
+        }
+    }
+    return true;
+}
+
+inline bool CopyCacheBlocks(const CacheInput& input, size_t first, size_t last, char kind, CacheWriter& out,
+    bool compactIds, CacheEditStats& stats, size_t& counter) {
+    for (size_t i = first; i < last; i++) {
+        const CacheIndexEntry& entry = input.index[i];
+        if (entry.kind != kind) continue;
+        out.BeginBlock(entry.kind, SpanString(entry.name));
+        if (!CopyCacheRecords(input, entry, out, compactIds, stats)) return false;
+        out.EndBlock();
+        counter++;
+    }
+    return true;
+}
+
+// Writes base with the blocks of partial (if given) merged in: for each name
+// and kind, partial's blocks when it has any, base's otherwise.
+inline bool WriteMergedCache(const CacheInput& base, const CacheInput* partial, const std::string& outPath,
+    bool compactIds, CacheEditStats& stats, std::string& error) {
+    ScopedPhase phase("merge");
+    CacheWriter out;
+    if (!out.Open(outPath.c_str())) {
+        error = "could not create " + outPath;
+        return false;
+    }
+
+    static const std::vector<CacheIndexEntry> kNoEntries;
+    const std::vector<CacheIndexEntry>& partialIndex = partial ? partial->index : kNoEntries;
+    bool ok = JoinCacheIndices(base.index, partialIndex, [&](size_t i, size_t iEnd, size_t j, size_t jEnd) {
+        for (char kind : { kIndexDocument, kIndexMesh }) {
+            bool inBase = HasKind(base.index, i, iEnd, kind);
+            if (HasKind(partialIndex, j, jEnd, kind)) {
+                size_t& counter = inBase ? stats.blocksReplaced : stats.blocksAdded;
+                if (!CopyCacheBlocks(*partial, j, jEnd, kind, out, compactIds, stats, counter)) return false;
+            }
+            else if (inBase && !CopyCacheBlocks(base, i, iEnd, kind, out, compactIds, stats, stats.blocksKept)) {
+                return false;
+            }
+        }
+        return true;
+    });
+    if (!ok) {
+        error = "input block is truncated or corrupt";
+        return false;
+    }
+
+    size_t blobCount = out.BlobCount();
+    if (!out.Close()) {
+        error = "could not write " + outPath;
+        return false;
+    }
+    phase.Count("bytes", out.BytesWritten());
+    BRIDGE_LOG("  " << stats.blocksKept << " blocks kept, " << stats.blocksReplaced << " replaced, "
+        << stats.blocksAdded << " added, " << blobCount << " shared payloads, "
+        << stats.idRecordsCompacted << " ID arrays compacted");
+    return true;
+}
+
+// merge (partialPath set) or compact. outPath may be one of the inputs: the
+// result is then written next to it and moved over it once the inputs are
+// closed.
+inline bool RunCacheMerge(const std::string& basePath, const std::string* partialPath, const std::string& outPath,
+    bool compactIds, std::string& error) {
+    CacheInput base, partial;
+    if (!OpenCacheInput(basePath, base, error)) return false;
+    if (partialPath && !OpenCacheInput(*partialPath, partial, error)) return false;
+
+    bool inPlace = outPath == basePath || (partialPath && outPath == *partialPath);
+    std::string writePath = inPlace ? outPath + ".merged" : outPath;
+    CacheEditStats stats;
+    if (!WriteMergedCache(base, partialPath ? &partial : nullptr, writePath, compactIds, stats, error)) return false;
+
+    base.mapping.Close();
+    partial.mapping.Close();
+    if (inPlace && !MoveFileOver(writePath, outPath)) {
+        std::remove(writePath.c_str());
+        error = "could not replace " + outPath;
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Diff
+// ============================================================================
+
+// One record, keyed by marker and property or user data name, with its
+// value resolved: blob references followed, island IDs decoded.
+struct DiffRecord {
+    PropertyType type = kPropertyNone;
+    ByteSpan value;
+    std::vector<int> ids;
+    uint8_t mapping = 0;
+    uint8_t reference = 0;
+};
+
+typedef std::map<std::pair<char, std::string>, DiffRecord> DiffRecordMap;
+
+inline bool ReadDiffRecords(const CacheInput& input, size_t first, size_t last, char kind, DiffRecordMap& records) {
+    for (size_t i = first; i < last; i++) {
+        if (input.index[i].kind != kind) continue;
+        CacheCursor block = BlockCursor(input.mapping, input.index[i]);
+        while (block.pos < block.end) {
+            CacheRecordHeader header;
+            ByteSpan span, name, key;
+            if (NextCacheRecord(block, input.checksums, header, span) != kRecordOk) return false;
+            CacheCursor cursor{ span.data, span.data + span.size };
+            DiffRecord record;
+
+            if (header.marker == 'G' || header.marker == 'M') {
+                if (!ReadString(cursor, name) || !ReadString(cursor, key) ||
+                    !ReadPropertyValue(cursor, header.flags, input.blobs, record.type, record.value)) return false;
+            }
+            else if (header.marker == 'I') {
+                IntSpan ids;
+                bool rle = (header.flags & kRecordFlagRleIds) != 0;
+                if (!ReadString(cursor, name) || !ReadString(cursor, key) ||
+                    !(rle ? ReadRleIntArray(cursor, ids) : ReadIntArray(cursor, ids))) return false;
+                record.ids.resize(ids.count);
+                if (!CopyInts(ids, record.ids.data())) return false;
+            }
+            else if (header.marker == 'U') {
+                // Keyed by layer, element and array; ints decoded as for 'I'.
+                UserDataArray array;
+                if (!ReadUserDataRecord(cursor, header.flags, name, array)) return false;
+                record.type = array.type;
+                record.mapping = array.mapping;
+                record.reference = array.reference;
+                if (array.type == kPropertyInt) {
+                    record.ids.resize(array.values.count);
+                    if (!CopyInts(array.values, record.ids.data())) return false;
+                }
+                else {
+                    record.value = ByteSpan{ array.values.data, array.values.size };
+                }
+                records[{ 'U', std::to_string(array.layer) + "/" + SpanString(array.elementName) + "/" +
+                    SpanString(array.arrayName) }] = std::move(record);
+                continue;
+            }
+            else if (header.marker == 'T' || header.marker == 'P') {
+                if (!ReadString(cursor, name)) return false;
+                record.value = ByteSpan{ cursor.pos, static_cast<size_t>(cursor.end - cursor.pos) };
+            }
+            else {
+                record.value = span;
+            }
+            records[{ header.marker, SpanString(key) }] = std::move(record);
+        }
+    }
+    return true;
+}
+
+inline bool SameDiffRecord(const DiffRecord& a, const DiffRecord& b) {
+    return a.type == b.type && a.ids == b.ids && a.mapping == b.mapping && a.reference == b.reference &&
+        a.value.size == b.value.size &&
+        (a.value.size == 0 || std::memcmp(a.value.data, b.value.data, a.value.size) == 0);
+}
+
+inline std::string DescribeDiffRecord(char marker, const std::string& key) {
+    switch (marker) {
+    case 'G':
+    case 'M': return "property '" + key + "'";
+    case 'I': return "island IDs '" + key + "'";
+    case 'U': return "user data '" + key + "'";
+    case 'T': return "topology";
+    case 'P': return "polygon samples";
+    default: return std::string("record '") + marker + "'";
+    }
+}
+
+inline std::string DescribeDiffChange(char marker, const DiffRecord& a, const DiffRecord& b) {
+    if (marker == 'U' && (a.mapping != b.mapping || a.reference != b.reference)) {
+        return std::string(" (") + UserDataMappingName(a.mapping) + "/" + UserDataReferenceName(a.reference) +
+            " -> " + UserDataMappingName(b.mapping) + "/" + UserDataReferenceName(b.reference) + ")";
+    }
+    if (marker == 'U' && a.type != b.type) {
+        return std::string(" (") + GetPropertyTypeInfo(a.type).name + " -> " + GetPropertyTypeInfo(b.type).name + ")";
+    }
+    if (marker == 'U' && a.type != kPropertyInt) {
+        size_t valueSize = PropertyValueSize(a.type);
+        return " (" + std::to_string(a.value.size / valueSize) + " -> " + std::to_string(b.value.size / valueSize) +
+            " values)";
+    }
+    if (marker == 'I' || marker == 'U') {
+        size_t differ = 0;
+        for (size_t i = 0; i < std::min(a.ids.size(), b.ids.size()); i++) differ += a.ids[i] != b.ids[i];
+        return " (" + std::to_string(a.ids.size()) + " -> " + std::to_string(b.ids.size()) + " IDs, " +
+            std::to_string(differ) + " differ)";
+    }
+    if (marker == 'G' || marker == 'M') {
+        return std::string(" (") + GetPropertyTypeInfo(a.type).name + ", " + std::to_string(a.value.size) +
+            " bytes -> " + GetPropertyTypeInfo(b.type).name + ", " + std::to_string(b.value.size) + " bytes)";
+    }
+    return std::string();
+}
+
+struct CacheDiffStats {
+    size_t added = 0;
+    size_t removed = 0;
+    size_t changed = 0;
+    size_t unchanged = 0;
+};
+
+// Prints one line per added ('+'), removed ('-') or changed ('~') block and
+// changed record. Returns false on a corrupt input.
+inline bool DiffCaches(const CacheInput& a, const CacheInput& b, std::ostream& out, CacheDiffStats& stats) {
+    return JoinCacheIndices(a.index, b.index, [&](size_t i, size_t iEnd, size_t j, size_t jEnd) {
+        const CacheIndexEntry& named = i < iEnd ? a.index[i] : b.index[j];
+        for (char kind : { kIndexDocument, kIndexMesh }) {
+            bool inA = HasKind(a.index, i, iEnd, kind), inB = HasKind(b.index, j, jEnd, kind);
+            if (!inA && !inB) continue;
+            std::string label = kind == kIndexDocument ? "[Document]" : SpanString(named.name);
+            if (inA != inB) {
+                out << (inA ? "- " : "+ ") << label << '\n';
+                (inA ? stats.removed : stats.added)++;
+                continue;
+            }
+
+            DiffRecordMap recordsA, recordsB;
+            if (!ReadDiffRecords(a, i, iEnd, kind, recordsA) || !ReadDiffRecords(b, j, jEnd, kind, recordsB)) {
+                return false;
+            }
+            bool changed = false;
+            auto report = [&](const std::string& line) {
+                if (!changed) out << "~ " << label << '\n';
+                changed = true;
+                out << "    " << line << '\n';
+            };
+            for (const auto& entry : recordsA) {
+                auto other = recordsB.find(entry.first);
+                std::string what = DescribeDiffRecord(entry.first.first, entry.first.second);
+                if (other == recordsB.end()) report("- " + what);
+                else if (!SameDiffRecord(entry.second, other->second)) {
+                    report("~ " + what + DescribeDiffChange(entry.first.first, entry.second, other->second));
+                }
+            }
+            for (const auto& entry : recordsB) {
+                if (!recordsA.count(entry.first)) report("+ " + DescribeDiffRecord(entry.first.first, entry.first.second));
+            }
+            (changed ? stats.changed : stats.unchanged)++;
+        }
+        return true;
+    });
+}
+
+// 0 if the caches hold the same data, 1 if they differ, 2 on an error.
+inline int RunCacheDiff(const std::string& pathA, const std::string& pathB, std::string& error) {
+    ScopedPhase phase("diff");
+    CacheInput a, b;
+    if (!OpenCacheInput(pathA, a, error) || !OpenCacheInput(pathB, b, error)) return 2;
+    CacheDiffStats stats;
+    if (!DiffCaches(a, b, std::cout, stats)) {
+        error = "input block is truncated or corrupt";
+        return 2;
+    }
+    BRIDGE_LOG("  " << stats.added << " added, " << stats.removed << " removed, " << stats.changed
+        << " changed, " << stats.unchanged << " unchanged");
+    return stats.added + stats.removed + stats.changed > 0 ? 1 : 0;
+}
+
+// ============================================================================
+// Verify
+// ============================================================================
+
+// Hashes the whole file once, which is all an intact v6 cache costs. Only on
+// a mismatch (or for an older cache, which has no checksums) are the index
+// and every record walked, to print where the damage is.
+// 0 if the cache is intact, 1 if it is corrupt, 2 if it cannot be checked.
+inline int RunCacheVerify(const std::string& path, std::ostream& out, std::string& error) {
+    ScopedPhase phase("verify");
+    MappedFile mapping;
+    if (!mapping.Open(path)) {
+        error = "could not open " + path;
+        return 2;
+    }
+    phase.Count("bytes", mapping.Size());
+    if (!HasCacheMagic(mapping.Data(), mapping.Size())) {
+        error = path + ": not an indexed cache (v1 caches have no checksums).";
+        return 2;
+    }
+    uint32_t version = CacheVersion(mapping);
+    if (version > kCacheVersion) {
+        error = path + ": cache version " + std::to_string(version) + " is newer than this tool supports.";
+        return 2;
+    }
+    if (version < kCacheIndexedVersion) {
+        error = path + ": header claims cache version " + std::to_string(version) + "; indexed caches start at " +
+            std::to_string(kCacheIndexedVersion) + ", so the header is corrupt.";
+        return 2;
+    }
+
+    bool checksums = HasCacheChecksums(version);
+    bool intact = false;
+    size_t trailerSize = sizeof(CacheFooter) + sizeof(uint64_t);
+    if (checksums && mapping.Size() >= sizeof(CacheHeader) + trailerSize) {
+        auto hashStart = std::chrono::steady_clock::now();
+        size_t hashed = mapping.Size() - trailerSize;
+        uint64_t fileHash;
+        std::memcpy(&fileHash, mapping.Data() + hashed, sizeof(fileHash));
+        intact = Xxh64Hash(mapping.Data(), hashed) == fileHash;
+        std::chrono::duration<double, std::milli> hashMs = std::chrono::steady_clock::now() - hashStart;
+        BRIDGE_LOG("  Hashed " << hashed << " bytes in " << hashMs.count() << " ms ("
+            << (hashMs.count() > 0 ? hashed / 1000.0 / hashMs.count() : 0.0) << " MB/s)");
+        if (!intact) out << "File hash mismatch.\n";
+    }
+
+    std::vector<CacheIndexEntry> index;
+    std::string indexError;
+    if (!ReadCacheIndex(mapping, index, indexError)) {
+        out << indexError << "\n";
+        return 1;
+    }
+    size_t records = 0, damaged = 0;
+    for (const CacheIndexEntry& entry : index) {
+        // An intact file still gets its shared payloads checked against their hashes.
+        if (intact && entry.kind != kIndexBlobs) continue;
+        CacheCursor block = BlockCursor(mapping, entry);
+        while (block.pos < block.end) {
+            const char* recordStart = block.pos;
+            CacheRecordHeader header;
+            ByteSpan body;
+            CacheRecordStatus status = NextCacheRecord(block, checksums, header, body);
+            if (status == kRecordOk && header.marker == 'B') {
+                // Shared payloads carry their own hash, in every version.
+                CacheCursor cursor{ body.data, body.data + body.size };
+                uint64_t hash = 0;
+                ByteSpan bytes;
+                bool hashMatches = false;
+                if (!ReadBlob(cursor, hash, bytes, hashMatches)) status = kRecordTruncated;
+                else if (!hashMatches) {
+                    damaged++;
+                    out << "Blob table: shared payload at offset "
+                        << (recordStart - mapping.Data()) << " does not match its hash\n";
+                    continue;
+                }
+            }
+            if (status == kRecordOk) {
+                records++;
+                continue;
+            }
+            damaged++;
+            out << "Block '" << SpanString(entry.name) << "': ";
+            if (status == kRecordTruncated) {
+                out << "truncated record at offset " << (recordStart - mapping.Data()) << "\n";
+                break;
+            }
+            out << "'" << header.marker << "' record at offset " << (recordStart - mapping.Data())
+                << " does not match its checksum\n";
+        }
+    }
+    // A file whose hash matches only had its blob table walked.
+    if (intact) BRIDGE_LOG("  File hash matches; " << records << " shared payloads intact, " << damaged << " damaged");
+    else BRIDGE_LOG("  " << index.size() << " blocks, " << records << " intact records, " << damaged << " damaged");
+    if (damaged > 0) return 1;
+    if (intact) return 0;
+    if (checksums) {
+        // The records check out, so the header or index was hit.
+        out << "Header or index is damaged.\n";
+        return 1;
+    }
+    out << "Version " << version << " cache has no checksums; only its layout and shared payloads were checked.\n";
+    return 0;
+}
@@ -0,0 +1,145 @@
+﻿#pragma once
+#include "Hash.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// ============================================================================
+// RizomUV cache (.dat) format
+// ============================================================================
+//
+// v1 (Extractor 1.0) is a bare stream of records with no header:
+//
+//   'G' | objectName | propName | typeName | value       document property
+//   'M' | meshName   | propName | typeName | value       mesh property
+//   'I' | meshName   | userDataName | int array          island group IDs
+//
+// Strings and blobs are uint32 length + bytes, int arrays uint32 count +
+// ints, all little-endian.
+//
+// v2 adds a record type, written after the other records of a mesh:
+//
+//   'T' | meshName | uint32 polygonCount | uint32 polygonVertexCount |
+//         uint32 binCount | binCount x uint32 | uint64 indexHash
+//                                                      topology fingerprint (Topology.h)
+//   'P' | meshName | uint32 polygonCount | polygonCount x float[6]
+//                                                      polygon centroid + normal (Remap.h)
+//
+// 'P' records are only written with Extractor --remap-data.
+//
+// v3 adds a blob table, so a payload shared by many objects (instanced or
+// duplicated assets) is stored once:
+//
+//   'B' | uint64 hash | uint32 length | bytes          shared payload
+//
+// Blob and string values of kSharedBlobMinSize bytes or more are stored in
+// the table, keyed by their XXH64 hash (Hash.h), and the property record
+// holds a uint32 table index instead of the value. Table entries are
+// numbered in file order and all sit in one block, indexed as kIndexBlobs
+// with an empty name, after the mesh blocks.
+//
+// v4 replaces the type name of 'G'/'M' records with a one-byte tag
+// (PropertyType.h), whose table entry says how the value is laid out:
+//
+//   'G' | objectName | propName | uint8 type | value
+//   'M' | meshName   | propName | uint8 type | value
+//
+// Fixed-size values (bool, int, enum, time, float, double, vectors, colours)
+// are stored raw; strings and blobs keep their uint32 length prefix.
+//
+// v5 replaces 'I' with one record per user data array, so every array of
+// every RizomUV user data element on every layer is kept, with its type and
+// the element's mapping and reference modes (UserData.h):
+//
+//   'U' | meshName | elementName | uint32 layer | uint8 mapping |
+//         uint8 reference | arrayName | uint8 type | uint32 count |
+//         count x value                                user data array
+//
+// type is a PropertyType tag (bool, int, float or double), values are
+// stored raw. The arrays of one element are consecutive records.
+//
+// v6 adds checksums, so corruption is caught before any of it is injected:
+// every record ends with a uint32 checksum, the low half of the XXH64 of its
+// header and body, and the index is followed by a uint64 file hash, the
+// XXH64 of every byte before it. A reader checks the records it parses;
+// cachetool verify checks the file hash, and the records only to locate a
+// mismatch.
+//
+// v2 wraps the same record bodies with a header, per-record lengths and an
+// index so a reader can jump straight to the meshes it needs:
+//
+//   CacheHeader
+//   records      : uint8 marker | uint8 flags | uint32 bodyLength | body
+//                  [| uint32 checksum (v6)]
+//   index        : per entry uint8 kind | name | uint64 offset | uint64 length
+//   [uint64 fileHash (v6)]
+//   CacheFooter
+//
+// Record flags change how a body is encoded; readers that predate a flag
+// fail cleanly on records that use it:
+//
+//   kRecordFlagRleIds   'I' record, or int 'U' record, holds run-length
+//                       encoded values (IdCodec.h)
+//   kRecordFlagBlobRef  'G'/'M' record holds a blob table index as its value
+//   kRecordFlagTypeTag  'G'/'M' record holds a type tag, not a type name
+//
+// A v2 reader would misread blob references, so caches that may hold them
+// are written as v3, which it refuses; type tags likewise need v4. A v4
+// reader would skip 'U' records as unknown, so they need v5; a v5 reader
+// would take checksums for the next record header, so they need v6.
+//
+// Index entries are sorted by name and cover one contiguous block of
+// records (all records of one node, or all document records). A name may
+// appear more than once if the scene has duplicate node names.
+
+const char kCacheMagic[8] = { 'R', 'Z', 'U', 'V', 'C', 'A', 'C', 'H' };
+const char kCacheFooterMagic[8] = { 'R', 'Z', 'U', 'V', 'I', 'N', 'D', 'X' };
+const uint32_t kCacheVersion = 6;
+const uint32_t kCacheIndexedVersion = 2;  // first version with this header
+const uint32_t kCacheChecksumVersion = 6;
+
+const char kIndexDocument = 'G';
+const char kIndexMesh = 'M';
+const char kIndexBlobs = 'B';
+
+const uint8_t kRecordFlagRleIds = 0x01;
+const uint8_t kRecordFlagBlobRef = 0x02;
+const uint8_t kRecordFlagTypeTag = 0x04;
+const size_t kSharedBlobMinSize = 16;
+
+#pragma pack(push, 1)
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+};
+
+struct CacheRecordHeader {
+    char marker;
+    uint8_t flags;
+    uint32_t bodyLength;
+};
+
+struct CacheFooter {
+    uint64_t indexOffset;
+    uint32_t indexCount;
+    uint32_t reserved;
+    char magic[8];
+};
+#pragma pack(pop)
+
+inline bool HasCacheChecksums(uint32_t version) {
+    return version >= kCacheChecksumVersion;
+}
+
+// Checksum stored after a v6 record: header and body are hashed as written.
+inline uint32_t CacheRecordChecksum(const CacheRecordHeader& header, const void* body, size_t size) {
+    Xxh64 hash;
+    hash.Update(&header, sizeof(header));
+    hash.Update(body, size);
+    return static_cast<uint32_t>(hash.Digest());
+}
+
+inline bool HasCacheMagic(const char* data, size_t size) {
+    return size >= sizeof(CacheHeader) && std::memcmp(data, kCacheMagic, sizeof(kCacheMagic)) == 0;
+}
@@ -0,0 +1,913 @@
+﻿#pragma once
+#include "BridgeLog.h"
+#include "CacheFormat.h"
+#include "IdCodec.h"
+#include "MappedFile.h"
+#include "MeshIndex.h"
+#include "NameFilter.h"
+#include "PropertyType.h"
+#include "Remap.h"
+#include "Topology.h"
+#include "UserData.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// Cache payload views
+// ============================================================================
+
+// count ints, stored raw or as an RLE stream of size bytes (IdCodec.h).
+struct IntSpan {
+    const char* data = nullptr;
+    size_t count = 0;
+    size_t size = 0;
+    bool rle = false;
+};
+
+inline bool CopyInts(const IntSpan& span, int* dst) {
+    if (span.rle) {
+        return DecodeRleIds(span.data, span.size, dst, span.count);
+    }
+    std::memcpy(dst, span.data, span.count * sizeof(int));
+    return true;
+}
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+struct CacheCursor {
+    const char* pos;
+    const char* end;
+
+    bool ReadU32(uint32_t& val) {
+        if (static_cast<size_t>(end - pos) < sizeof(val)) return false;
+        std::memcpy(&val, pos, sizeof(val));
+        pos += sizeof(val);
+        return true;
+    }
+
+    bool ReadBytes(size_t len, ByteSpan& span) {
+        if (static_cast<size_t>(end - pos) < len) return false;
+        span.data = pos;
+        span.size = len;
+        pos += len;
+        return true;
+    }
+};
+
+// Length-prefixed string, left in the mapping; callers copy what they keep.
+inline bool ReadString(CacheCursor& in, ByteSpan& str) {
+    uint32_t len;
+    return in.ReadU32(len) && in.ReadBytes(len, str);
+}
+
+inline bool ReadIntArray(CacheCursor& in, IntSpan& arr) {
+    uint32_t count;
+    ByteSpan span;
+    if (!in.ReadU32(count) || !in.ReadBytes(static_cast<size_t>(count) * sizeof(int), span)) return false;
+    arr.data = span.data;
+    arr.count = count;
+    arr.size = span.size;
+    arr.rle = false;
+    return true;
+}
+
+// Body of a 'B' record. Writers deduplicate payloads by the stored hash, so a
+// payload that no longer matches it is corrupt: hashMatches reports that.
+inline bool ReadBlob(CacheCursor& in, uint64_t& hash, ByteSpan& bytes, bool& hashMatches) {
+    uint32_t size = 0;
+    ByteSpan hashBytes;
+    if (!in.ReadBytes(sizeof(hash), hashBytes) || !in.ReadU32(size) || !in.ReadBytes(size, bytes)) return false;
+    std::memcpy(&hash, hashBytes.data, sizeof(hash));
+    hashMatches = Xxh64Hash(bytes.data, bytes.size) == hash;
+    return true;
+}
+
+// The runs are validated here so a bad stream fails the load, not the
+// injection.
+inline bool ReadRleIntArray(CacheCursor& in, IntSpan& arr) {
+    uint32_t count, size;
+    ByteSpan span;
+    if (!in.ReadU32(count) || !in.ReadU32(size) || !in.ReadBytes(size, span)) return false;
+    if (!DecodeRleIds(span.data, span.size, nullptr, count)) return false;
+    arr.data = span.data;
+    arr.count = count;
+    arr.size = size;
+    arr.rle = true;
+    return true;
+}
+
+inline bool ReadValue(CacheCursor& in, PropertyType type, ByteSpan& data) {
+    if (size_t size = PropertyValueSize(type)) return in.ReadBytes(size, data);
+    uint32_t size;
+    return in.ReadU32(size) && in.ReadBytes(size, data);
+}
+
+// v4 records carry a type tag. Older ones carry a type name, and only ints,
+// strings and blobs were ever written with a value.
+inline bool ReadPropertyType(CacheCursor& in, uint8_t flags, PropertyType& type) {
+    if (flags & kRecordFlagTypeTag) {
+        ByteSpan tag;
+        if (!in.ReadBytes(1, tag)) return false;
+        type = static_cast<PropertyType>(*tag.data);
+        if (IsPropertyType(type)) return true;
+        BridgeErrorStream() << "\nError: Unknown property type tag " << static_cast<int>(type) << std::endl;
+        return false;
+    }
+    ByteSpan typeName;
+    if (!ReadString(in, typeName)) return false;
+    type = PropertyTypeFromName(typeName.data, typeName.size);
+    if (type == kPropertyInt || type == kPropertyString || type == kPropertyUrl || type == kPropertyBlob) return true;
+    BridgeErrorStream() << "\nError: Unknown property type '" << std::string(typeName.data, typeName.size) << "'" << std::endl;
+    return false;
+}
+
+// Shared payloads of a v3+ cache by table index (CacheFormat.h). Every
+// record referring to one gets the same span into the mapping.
+typedef std::vector<ByteSpan> BlobTable;
+
+// A property type and value, stored inline or, with kRecordFlagBlobRef, as a
+// blob table index (only length-prefixed values are shared).
+inline bool ReadPropertyValue(CacheCursor& in, uint8_t flags, const BlobTable& blobs,
+    PropertyType& type, ByteSpan& data) {
+    if (!ReadPropertyType(in, flags, type)) return false;
+    if (!(flags & kRecordFlagBlobRef)) return ReadValue(in, type, data);
+    uint32_t blobIndex;
+    if (PropertyValueSize(type) != 0 || !in.ReadU32(blobIndex) || blobIndex >= blobs.size()) return false;
+    data = blobs[blobIndex];
+    return true;
+}
+
+// ============================================================================
+// Cache data
+// ============================================================================
+
+struct CacheProperty {
+    PropertyType type = kPropertyNone;
+    ByteSpan value;
+};
+
+// One array of a user data element (UserData.h), from a 'U' record or the
+// 'I' record of a v1-v4 cache. Names and values point into the mapping;
+// values holds count values of type, run-length encoded only for ints.
+struct UserDataArray {
+    ByteSpan elementName;
+    uint32_t layer = 0;
+    uint8_t mapping = kMappingByPolygon;
+    uint8_t reference = kReferenceDirect;
+    ByteSpan arrayName;
+    PropertyType type = kPropertyInt;
+    IntSpan values;
+};
+
+inline bool SpanEquals(const ByteSpan& a, const ByteSpan& b) {
+    return a.size == b.size && (a.size == 0 || std::memcmp(a.data, b.data, a.size) == 0);
+}
+
+inline bool SameUserDataElement(const UserDataArray& a, const UserDataArray& b) {
+    return a.layer == b.layer && SpanEquals(a.elementName, b.elementName);
+}
+
+// dst receives values.count values of PropertyValueSize(type) bytes each.
+inline bool CopyUserDataValues(const UserDataArray& array, void* dst) {
+    if (array.values.rle) return CopyInts(array.values, static_cast<int*>(dst));
+    if (array.values.size > 0) std::memcpy(dst, array.values.data, array.values.size);
+    return true;
+}
+
+// Body of a 'U' record.
+inline bool ReadUserDataRecord(CacheCursor& in, uint8_t flags, ByteSpan& meshName, UserDataArray& array) {
+    ByteSpan modes, type, values;
+    uint32_t count = 0;
+    if (!ReadString(in, meshName) || !ReadString(in, array.elementName) || !in.ReadU32(array.layer) ||
+        !in.ReadBytes(2, modes) || !ReadString(in, array.arrayName) || !in.ReadBytes(1, type)) return false;
+    array.mapping = static_cast<uint8_t>(modes.data[0]);
+    array.reference = static_cast<uint8_t>(modes.data[1]);
+    array.type = static_cast<PropertyType>(*type.data);
+    if (!IsUserDataType(array.type)) return false;
+    if (flags & kRecordFlagRleIds) return array.type == kPropertyInt && ReadRleIntArray(in, array.values);
+    if (!in.ReadU32(count) || !in.ReadBytes(static_cast<size_t>(count) * PropertyValueSize(array.type), values)) {
+        return false;
+    }
+    array.values.data = values.data;
+    array.values.count = count;
+    array.values.size = values.size;
+    array.values.rle = false;
+    return true;
+}
+
+// Names are allocated from the arena of the LoadedCache they belong to;
+// std::less<> lets lookups by literal skip the temporary.
+typedef std::pmr::string CacheString;
+typedef std::pmr::map<CacheString, CacheProperty, std::less<>> PropertyMap;
+
+inline std::string ToString(const CacheString& str) {
+    return std::string(str.data(), str.size());
+}
+
+// Spans point into the mapping of the LoadedCache, which must outlive the
+// injection. Allocator-aware, so a NameTable built on an arena constructs
+// its GeometryData there too.
+struct GeometryData {
+    typedef std::pmr::polymorphic_allocator<char> allocator_type;
+
+    GeometryData() = default;
+    explicit GeometryData(const allocator_type& alloc) : properties(alloc), userData(alloc) {}
+    GeometryData(const GeometryData& other, const allocator_type& alloc) : GeometryData(alloc) { *this = other; }
+    GeometryData(GeometryData&& other, const allocator_type& alloc) : GeometryData(alloc) { *this = std::move(other); }
+    GeometryData(const GeometryData&) = default;
+    GeometryData(GeometryData&&) = default;
+    GeometryData& operator=(const GeometryData&) = default;
+    GeometryData& operator=(GeometryData&&) = default;
+
+    PropertyMap properties;
+    std::pmr::vector<UserDataArray> userData;  // the arrays of an element are adjacent
+    TopologyFingerprint topology;
+    bool hasTopology = false;  // caches written before fingerprints have none
+    ByteSpan polygonSamples;   // sampleCount PolygonSamples, unaligned (Remap.h)
+    uint32_t sampleCount = 0;
+
+    // Nothing to inject: only a fingerprint or samples were cached.
+    bool Empty() const { return properties.empty() && userData.empty(); }
+};
+
+inline std::vector<PolygonSample> CopySamples(const GeometryData& geoData) {
+    std::vector<PolygonSample> samples(geoData.sampleCount);
+    if (geoData.sampleCount > 0) std::memcpy(samples.data(), geoData.polygonSamples.data, geoData.polygonSamples.size);
+    return samples;
+}
+
+// End of the run of arrays belonging to the element of userData[first].
+inline size_t UserDataElementEnd(const std::pmr::vector<UserDataArray>& userData, size_t first) {
+    size_t last = first + 1;
+    while (last < userData.size() && SameUserDataElement(userData[last], userData[first])) last++;
+    return last;
+}
+
+// A later record for the same array replaces the earlier one.
+inline void AddUserDataArray(GeometryData& geoData, const UserDataArray& array) {
+    for (UserDataArray& existing : geoData.userData) {
+        if (SameUserDataElement(existing, array) && SpanEquals(existing.arrayName, array.arrayName)) {
+            existing = array;
+            return;
+        }
+    }
+    geoData.userData.push_back(array);
+}
+
+// Whether there is user data and the cache holds one polygon sample per
+// value of every array, i.e. all of it is mapped directly by polygon.
+inline bool CanRemapUserData(const GeometryData& geoData) {
+    if (geoData.userData.empty() || geoData.sampleCount == 0) return false;
+    for (const UserDataArray& array : geoData.userData) {
+        if (array.mapping != kMappingByPolygon || array.reference != kReferenceDirect ||
+            array.values.count != geoData.sampleCount) return false;
+    }
+    return true;
+}
+
+// Values of each entry of geoData.userData, one per target polygon.
+typedef std::vector<std::vector<char>> RemappedUserData;
+
+// User data of the cached polygons carried over onto the target polygons
+// (Remap.h), every array through the same nearest-polygon lookup; false if
+// CanRemapUserData does not hold or the values are corrupt.
+inline bool RemapUserData(const GeometryData& geoData, const std::vector<PolygonSample>& target,
+    RemappedUserData& remapped) {
+    if (!CanRemapUserData(geoData)) return false;
+    std::vector<int64_t> nearest;
+    NearestPolygons(CopySamples(geoData), target, nearest);
+
+    remapped.assign(geoData.userData.size(), std::vector<char>());
+    std::vector<char> values;
+    for (size_t a = 0; a < geoData.userData.size(); a++) {
+        const UserDataArray& array = geoData.userData[a];
+        size_t valueSize = PropertyValueSize(array.type);
+        values.resize(array.values.count * valueSize);
+        if (!CopyUserDataValues(array, values.data())) return false;
+        remapped[a].assign(target.size() * valueSize, 0);
+        for (size_t i = 0; i < target.size(); i++) {
+            if (nearest[i] < 0) continue;
+            std::memcpy(&remapped[a][i * valueSize], &values[static_cast<size_t>(nearest[i]) * valueSize], valueSize);
+        }
+    }
+    return true;
+}
+
+// Keyed by the node/mesh name stored in the cache, built once while loading.
+typedef NameTable<GeometryData> GeometryTable;
+
+inline const CacheProperty* FindProperty(const PropertyMap& properties, const char* propName) {
+    auto it = properties.find(propName);
+    return it == properties.end() ? nullptr : &it->second;
+}
+
+// A later record for the same property replaces the earlier one.
+inline const CacheString& SetProperty(PropertyMap& properties, const ByteSpan& propName,
+    PropertyType type, const ByteSpan& data) {
+    auto& entry = *properties.try_emplace(CacheString(propName.data, propName.size, properties.get_allocator())).first;
+    entry.second.type = type;
+    entry.second.value = data;
+    return entry.first;
+}
+
+// ============================================================================
+// Loaded cache
+// ============================================================================
+//
+// Everything LoadAllDataFromFile builds besides the spans (property, mesh
+// and user-data names, map nodes, the mesh table) is carved out of one
+// monotonic arena: a cache with thousands of meshes costs a handful of
+// upstream allocations instead of several per record, and destroying the
+// LoadedCache releases the lot in one step. Members are declared so the
+// arena outlives the containers using it.
+
+const size_t kCacheArenaBlockSize = 64 * 1024;
+
+struct LoadedCache {
+    LoadedCache() : arena(kCacheArenaBlockSize), documentProperties(&arena), geometryData(&arena) {}
+    LoadedCache(const LoadedCache&) = delete;
+    LoadedCache& operator=(const LoadedCache&) = delete;
+
+    MappedFile mapping;
+    std::pmr::monotonic_buffer_resource arena;
+    PropertyMap documentProperties;
+    GeometryTable geometryData;
+};
+
+// ============================================================================
+// Loading
+// ============================================================================
+
+// Parses one record body (everything after the marker). Shared by the v1
+// stream and the v2 indexed layout, whose bodies are identical apart from
+// what the v2 record flags select.
+inline bool ParseRecord(char marker, uint8_t flags, CacheCursor& dataFile, PropertyMap& documentProperties,
+    GeometryTable& geometryData, BlobTable& blobs) {
+
+    // Names stay spans into the mapping until copied into the arena.
+    if (marker == 'G') {
+        ByteSpan objectName, propName, data;
+        PropertyType type;
+        if (!ReadString(dataFile, objectName) || !ReadString(dataFile, propName) ||
+            !ReadPropertyValue(dataFile, flags, blobs, type, data)) return false;
+        const CacheString& name = SetProperty(documentProperties, propName, type, data);
+        BRIDGE_LOG_ITEM("  [Document] Property '" << name << "' (" << data.size << " bytes)");
+
+    }
+    else if (marker == 'M') {
+        ByteSpan meshName, propName, data;
+        PropertyType type;
+        if (!ReadString(dataFile, meshName) || !ReadString(dataFile, propName) ||
+            !ReadPropertyValue(dataFile, flags, blobs, type, data)) return false;
+        GeometryData& geoData = geometryData.Insert(meshName.data, meshName.size);
+        const CacheString& name = SetProperty(geoData.properties, propName, type, data);
+        BRIDGE_LOG_ITEM("  [" << std::string(meshName.data, meshName.size) << "] Property '" << name
+            << "' (" << data.size << " bytes)");
+
+    }
+    else if (marker == 'U') {
+        ByteSpan meshName;
+        UserDataArray array;
+        if (!ReadUserDataRecord(dataFile, flags, meshName, array)) return false;
+        GeometryData& geoData = geometryData.Insert(meshName.data, meshName.size);
+        AddUserDataArray(geoData, array);
+        BRIDGE_LOG_ITEM("  [" << std::string(meshName.data, meshName.size) << "] UserData '"
+            << std::string(array.elementName.data, array.elementName.size) << "' layer " << array.layer << " array '"
+            << std::string(array.arrayName.data, array.arrayName.size) << "' (" << array.values.count << " "
+            << GetPropertyTypeInfo(array.type).name << ")");
+    }
+    else if (marker == 'I') {
+        // v1-v4: island IDs only, and the injectors of the time kept the
+        // last element of a mesh, on layer 0. So does this.
+        ByteSpan meshName;
+        UserDataArray array;
+        if (!ReadString(dataFile, meshName) || !ReadString(dataFile, array.elementName)) return false;
+        bool ok = (flags & kRecordFlagRleIds) ? ReadRleIntArray(dataFile, array.values) : ReadIntArray(dataFile, array.values);
+        if (!ok) return false;
+        static const char kIslandArrayName[] = "IslandGroupID";
+        array.arrayName = ByteSpan{ kIslandArrayName, sizeof(kIslandArrayName) - 1 };
+        GeometryData& geoData = geometryData.Insert(meshName.data, meshName.size);
+        geoData.userData.clear();
+        geoData.userData.push_back(array);
+        BRIDGE_LOG_ITEM("  [" << std::string(meshName.data, meshName.size) << "] UserData '"
+            << std::string(array.elementName.data, array.elementName.size) << "' (" << array.values.count << " IDs)");
+    }
+    else if (marker == 'T') {
+        ByteSpan meshName;
+        TopologyFingerprint topology;
+        uint32_t binCount = 0;
+        ByteSpan bins, hash;
+        if (!ReadString(dataFile, meshName) || !dataFile.ReadU32(topology.polygonCount) ||
+            !dataFile.ReadU32(topology.polygonVertexCount) || !dataFile.ReadU32(binCount) ||
+            binCount != kTopologySizeBins ||
+            !dataFile.ReadBytes(sizeof(topology.sizeBins), bins) ||
+            !dataFile.ReadBytes(sizeof(topology.indexHash), hash)) return false;
+        std::memcpy(topology.sizeBins, bins.data, bins.size);
+        std::memcpy(&topology.indexHash, hash.data, hash.size);
+        GeometryData& geoData = geometryData.Insert(meshName.data, meshName.size);
+        geoData.topology = topology;
+        geoData.hasTopology = true;
+        BRIDGE_LOG_ITEM("  [" << std::string(meshName.data, meshName.size) << "] Topology (" << topology.polygonCount << " polygons)");
+    }
+    else if (marker == 'P') {
+        ByteSpan meshName, samples;
+        uint32_t count = 0;
+        if (!ReadString(dataFile, meshName) || !dataFile.ReadU32(count) ||
+            !dataFile.ReadBytes(static_cast<size_t>(count) * sizeof(PolygonSample), samples)) return false;
+        GeometryData& geoData = geometryData.Insert(meshName.data, meshName.size);
+        geoData.polygonSamples = samples;
+        geoData.sampleCount = count;
+        BRIDGE_LOG_ITEM("  [" << std::string(meshName.data, meshName.size) << "] Polygon samples (" << count << ")");
+    }
+    else if (marker == 'B') {
+        uint64_t hash = 0;
+        ByteSpan bytes;
+        bool hashMatches = false;
+        if (!ReadBlob(dataFile, hash, bytes, hashMatches)) return false;
+        if (!hashMatches) {
+            BridgeErrorStream() << "\nError: Shared payload " << blobs.size() << " does not match its hash" << std::endl;
+            return false;
+        }
+        blobs.push_back(bytes);
+    }
+    else {
+        BridgeErrorStream() << "\nError: Unknown record marker '" << marker << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// v1: unversioned record stream, read front to back.
+inline bool LoadStreamCache(const MappedFile& mapping, PropertyMap& documentProperties,
+    GeometryTable& geometryData) {
+
+    CacheCursor dataFile{ mapping.Data(), mapping.Data() + mapping.Size() };
+    BlobTable blobs;
+    while (dataFile.pos < dataFile.end) {
+        char marker = *dataFile.pos++;
+        if (!ParseRecord(marker, 0, dataFile, documentProperties, geometryData, blobs)) {
+            BridgeErrorStream() << "Error: Cache record at offset " << (dataFile.pos - mapping.Data())
+                << " is truncated or corrupt." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+struct CacheIndexEntry {
+    char kind;
+    ByteSpan name;
+    uint64_t offset;
+    uint64_t length;
+};
+
+inline bool SpanLess(const ByteSpan& a, const ByteSpan& b) {
+    return std::lexicographical_compare(a.data, a.data + a.size, b.data, b.data + b.size);
+}
+
+inline bool IndexNameLess(const CacheIndexEntry& entry, const std::string& name) {
+    return std::lexicographical_compare(entry.name.data, entry.name.data + entry.name.size,
+        name.begin(), name.end());
+}
+
+inline bool IndexNameGreater(const std::string& name, const CacheIndexEntry& entry) {
+    return std::lexicographical_compare(name.begin(), name.end(),
+        entry.name.data, entry.name.data + entry.name.size);
+}
+
+inline CacheCursor BlockCursor(const MappedFile& mapping, const CacheIndexEntry& entry) {
+    return CacheCursor{ mapping.Data() + entry.offset, mapping.Data() + entry.offset + entry.length };
+}
+
+// Version of a v2+ cache (see HasCacheMagic).
+inline uint32_t CacheVersion(const MappedFile& mapping) {
+    CacheHeader header;
+    std::memcpy(&header, mapping.Data(), sizeof(header));
+    return header.version;
+}
+
+enum CacheRecordStatus {
+    kRecordOk,
+    kRecordTruncated,  // or otherwise unreadable
+    kRecordCorrupt     // does not match its checksum
+};
+
+// Next record of a v2+ block. With checksums (v6+) the record's trailing
+// checksum is checked and skipped.
+inline CacheRecordStatus NextCacheRecord(CacheCursor& block, bool checksums, CacheRecordHeader& header,
+    ByteSpan& body) {
+    if (static_cast<size_t>(block.end - block.pos) < sizeof(header)) return kRecordTruncated;
+    std::memcpy(&header, block.pos, sizeof(header));
+    block.pos += sizeof(header);
+    if (!block.ReadBytes(header.bodyLength, body)) return kRecordTruncated;
+    if (!checksums) return kRecordOk;
+    uint32_t checksum = 0;
+    if (!block.ReadU32(checksum)) return kRecordTruncated;
+    return checksum == CacheRecordChecksum(header, body.data, body.size) ? kRecordOk : kRecordCorrupt;
+}
+
+inline CacheRecordStatus LoadIndexedBlock(const MappedFile& mapping, const CacheIndexEntry& entry, bool checksums,
+    PropertyMap& documentProperties, GeometryTable& geometryData, BlobTable& blobs) {
+
+    CacheCursor block = BlockCursor(mapping, entry);
+    while (block.pos < block.end) {
+        CacheRecordHeader header;
+        ByteSpan bodySpan;
+        CacheRecordStatus status = NextCacheRecord(block, checksums, header, bodySpan);
+        if (status != kRecordOk) return status;
+
+        if (header.marker != 'G' && header.marker != 'M' && header.marker != 'I' && header.marker != 'U' &&
+            header.marker != 'T' && header.marker != 'P' && header.marker != 'B') {
+            BRIDGE_LOG_ITEM("  Skipping unknown record '" << header.marker << "' (" << header.bodyLength << " bytes)");
+            continue;
+        }
+
+        CacheCursor body{ bodySpan.data, bodySpan.data + bodySpan.size };
+        if (!ParseRecord(header.marker, header.flags, body, documentProperties, geometryData, blobs)) {
+            return kRecordTruncated;
+        }
+    }
+    return kRecordOk;
+}
+
+// Index of a v2+ cache (header, records, sorted index, footer; see
+// CacheFormat.h), checked for order and bounds.
+inline bool ReadCacheIndex(const MappedFile& mapping, std::vector<CacheIndexEntry>& index, std::string& error) {
+    CacheHeader header;
+    if (!HasCacheMagic(mapping.Data(), mapping.Size())) {
+        error = "Not an indexed cache (v1 caches have no index).";
+        return false;
+    }
+    std::memcpy(&header, mapping.Data(), sizeof(header));
+    if (header.version > kCacheVersion) {
+        error = "Cache version " + std::to_string(header.version) + " is newer than this tool supports.";
+        return false;
+    }
+    if (header.version < kCacheIndexedVersion) {
+        error = "Cache header claims version " + std::to_string(header.version) + ", but indexed caches start at " +
+            std::to_string(kCacheIndexedVersion) + "; the cache is corrupt.";
+        return false;
+    }
+
+    CacheFooter footer;
+    size_t trailerSize = sizeof(footer) + (HasCacheChecksums(header.version) ? sizeof(uint64_t) : 0);
+    if (mapping.Size() < sizeof(header) + trailerSize) {
+        error = "Cache is truncated (no footer).";
+        return false;
+    }
+    std::memcpy(&footer, mapping.Data() + mapping.Size() - sizeof(footer), sizeof(footer));
+    uint64_t indexEnd = mapping.Size() - trailerSize;
+    if (std::memcmp(footer.magic, kCacheFooterMagic, sizeof(footer.magic)) != 0 ||
+        footer.indexOffset < sizeof(header) || footer.indexOffset > indexEnd) {
+        error = "Cache is truncated or corrupt (bad footer).";
+        return false;
+    }
+
+    // Each entry takes at least kind + name length + offset + length bytes,
+    // so a count the index area cannot hold is rejected before reserving.
+    const uint64_t minEntrySize = 1 + sizeof(uint32_t) + 2 * sizeof(uint64_t);
+    if (footer.indexCount > (indexEnd - footer.indexOffset) / minEntrySize) {
+        error = "Cache is truncated or corrupt (bad index count).";
+        return false;
+    }
+
+    index.clear();
+    index.reserve(footer.indexCount);
+    CacheCursor indexCursor{ mapping.Data() + footer.indexOffset, mapping.Data() + indexEnd };
+    for (uint32_t i = 0; i < footer.indexCount; i++) {
+        CacheIndexEntry entry;
+        uint32_t nameLen;
+        ByteSpan kind, offset, length;
+        if (!indexCursor.ReadBytes(1, kind) || !indexCursor.ReadU32(nameLen) ||
+            !indexCursor.ReadBytes(nameLen, entry.name) ||
+            !indexCursor.ReadBytes(sizeof(uint64_t), offset) ||
+            !indexCursor.ReadBytes(sizeof(uint64_t), length)) {
+            error = "Cache index is truncated.";
+            return false;
+        }
+        entry.kind = *kind.data;
+        std::memcpy(&entry.offset, offset.data, sizeof(entry.offset));
+        std::memcpy(&entry.length, length.data, sizeof(entry.length));
+        if (entry.offset < sizeof(header) || entry.offset > footer.indexOffset ||
+            entry.length > footer.indexOffset - entry.offset) {
+            error = "Cache index entry points outside the record area.";
+            return false;
+        }
+        if (!index.empty() && SpanLess(entry.name, index.back().name)) {
+            error = "Cache index is not sorted.";
+            return false;
+        }
+        index.push_back(entry);
+    }
+    return true;
+}
+
+// Loads a v2+ cache in steps: the blob table and the document block, then
+// mesh blocks by name filter or by name, each block once. The Injector
+// parses most blocks in the background this way and the rest once it knows
+// the target scene (PendingCache).
+class IndexedCacheLoader {
+public:
+    IndexedCacheLoader(const MappedFile& mapping, PropertyMap& documentProperties, GeometryTable& geometryData)
+        : mapping(mapping), documentProperties(documentProperties), geometryData(geometryData) {}
+
+    bool Begin() {
+        std::string error;
+        if (!ReadCacheIndex(mapping, index, error)) {
+            BridgeErrorStream() << "Error: " << error << std::endl;
+            return false;
+        }
+        loaded.assign(index.size(), 0);
+        checksums = HasCacheChecksums(CacheVersion(mapping));
+
+        // The blob table first: document and mesh records refer into it.
+        for (size_t i = 0; i < index.size(); i++) {
+            if (index[i].kind == kIndexBlobs && !LoadBlock(i)) return false;
+        }
+        for (size_t i = 0; i < index.size(); i++) {
+            if (index[i].kind == kIndexDocument && !LoadBlock(i)) return false;
+        }
+        return true;
+    }
+
+    // Mesh blocks whose name passes select(ByteSpan).
+    template <typename Select>
+    bool LoadMeshes(Select select) {
+        for (size_t i = 0; i < index.size(); i++) {
+            if (index[i].kind == kIndexMesh && !loaded[i] && select(index[i].name) && !LoadBlock(i)) return false;
+        }
+        return true;
+    }
+
+    bool LoadWanted(const std::set<std::string>& wantedMeshes) {
+        for (const std::string& name : wantedMeshes) {
+            auto first = std::lower_bound(index.begin(), index.end(), name, IndexNameLess);
+            auto last = std::upper_bound(first, index.end(), name, IndexNameGreater);
+            for (auto it = first; it != last; ++it) {
+                size_t i = static_cast<size_t>(it - index.begin());
+                if (it->kind == kIndexMesh && !loaded[i] && !LoadBlock(i)) return false;
+            }
+        }
+        return true;
+    }
+
+    void LogSummary() const {
+        BRIDGE_LOG("  Read " << blocksRead << " of " << index.size() << " indexed blocks, "
+            << blobs.size() << " shared payloads");
+    }
+
+private:
+    bool LoadBlock(size_t i) {
+        const CacheIndexEntry& entry = index[i];
+        loaded[i] = 1;
+        blocksRead++;
+        CacheRecordStatus status = LoadIndexedBlock(mapping, entry, checksums, documentProperties, geometryData, blobs);
+        if (status == kRecordOk) return true;
+        std::string block = entry.kind == kIndexBlobs ? "Blob table" : entry.kind == kIndexDocument ? "Document block" :
+            "Cache block '" + std::string(entry.name.data, entry.name.size) + "'";
+        BridgeErrorStream() << "Error: " << block
+            << (status == kRecordCorrupt ? " does not match its checksum; the cache is corrupt."
+                : " is truncated or corrupt.") << std::endl;
+        return false;
+    }
+
+    const MappedFile& mapping;
+    PropertyMap& documentProperties;
+    GeometryTable& geometryData;
+    std::vector<CacheIndexEntry> index;
+    std::vector<char> loaded;
+    BlobTable blobs;
+    bool checksums = false;
+    size_t blocksRead = 0;
+};
+
+// v2+: only the document block and the blocks of wantedMeshes are parsed.
+inline bool LoadIndexedCache(const MappedFile& mapping, PropertyMap& documentProperties,
+    GeometryTable& geometryData,
+    const std::set<std::string>* wantedMeshes) {
+
+    IndexedCacheLoader loader(mapping, documentProperties, geometryData);
+    if (!loader.Begin()) return false;
+    bool loadedMeshes = wantedMeshes ? loader.LoadWanted(*wantedMeshes)
+        : loader.LoadMeshes([](const ByteSpan&) { return true; });
+    if (!loadedMeshes) return false;
+    loader.LogSummary();
+    return true;
+}
+
+inline bool LoadMappedCache(LoadedCache& cache, const std::set<std::string>* wantedMeshes) {
+    if (wantedMeshes) cache.geometryData.Reserve(wantedMeshes->size());
+    if (HasCacheMagic(cache.mapping.Data(), cache.mapping.Size())) {
+        return LoadIndexedCache(cache.mapping, cache.documentProperties, cache.geometryData, wantedMeshes);
+    }
+    return LoadStreamCache(cache.mapping, cache.documentProperties, cache.geometryData);
+}
+
+// Reads v1 to v6 caches. wantedMeshes (node or mesh names present in the
+// target scene) limits which mesh records a v2+ cache parses; v1 has no index
+// and is always read in full.
+inline bool LoadAllDataFromFile(const std::string& dataFilePath, LoadedCache& cache,
+    const std::set<std::string>* wantedMeshes = nullptr) {
+
+    ScopedPhase phase("cache_read");
+    if (!cache.mapping.Open(dataFilePath)) {
+        BridgeErrorStream() << "Error: Could not open data file.\n";
+        return false;
+    }
+    phase.Count("bytes", cache.mapping.Size());
+
+    BRIDGE_LOG("\n=== Loading data from file ===");
+    return LoadMappedCache(cache, wantedMeshes);
+}
+
+// Same for a cache already in memory; data must outlive cache.
+inline bool LoadAllDataFromMemory(const char* data, size_t size, LoadedCache& cache,
+    const std::set<std::string>* wantedMeshes = nullptr) {
+
+    ScopedPhase phase("cache_read");
+    cache.mapping.Borrow(data, size);
+    phase.Count("bytes", size);
+
+    BRIDGE_LOG("\n=== Loading data from memory ===");
+    return LoadMappedCache(cache, wantedMeshes);
+}
+
+// A cache to inject: a .dat file, or bytes in memory (library API).
+struct CacheSource {
+    const char* path = nullptr;
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+inline std::string CacheSourceName(const CacheSource& source) {
+    return source.path ? std::string(source.path) : std::string("<memory>");
+}
+
+inline bool LoadCache(const CacheSource& source, LoadedCache& cache,
+    const std::set<std::string>* wantedMeshes = nullptr) {
+    if (source.path) return LoadAllDataFromFile(source.path, cache, wantedMeshes);
+    return LoadAllDataFromMemory(source.data, source.size, cache, wantedMeshes);
+}
+
+// ============================================================================
+// Background loading
+// ============================================================================
+
+// Loads a cache on a worker thread while the caller reads the target scene.
+// The worker maps the file, checks the index and parses the document block
+// plus every mesh block the name filter selects by its cache name. Wait
+// joins it and parses the blocks the scene names that the filter could only
+// have matched by mesh name, so the result equals LoadCache with the same
+// wanted set.
+class PendingCache {
+public:
+    PendingCache() = default;
+    PendingCache(const PendingCache&) = delete;
+    PendingCache& operator=(const PendingCache&) = delete;
+    ~PendingCache() { Join(); }
+
+    void Start(const CacheSource& cacheSource, const NameFilter& nameFilter) {
+        source = cacheSource;
+        filter = &nameFilter;
+        worker = std::thread([this] { Load(); });
+    }
+
+    // nullptr if the cache could not be loaded, with the reason in Error().
+    // May be called again with another wanted set; blocks already parsed are
+    // not read twice. The worker's log lines are printed here, on the calling
+    // thread, so they do not interleave with the caller's.
+    LoadedCache* Wait(const std::set<std::string>* wantedMeshes) {
+        auto waitStart = std::chrono::steady_clock::now();
+        Join();
+        waitMs += ElapsedMs(waitStart);
+
+        if (ok && loader) {
+            auto finishStart = std::chrono::steady_clock::now();
+            BridgeThreadCapture() = &capture;
+            Guarded([&] {
+                ok = wantedMeshes ? loader->LoadWanted(*wantedMeshes)
+                    : loader->LoadMeshes([](const ByteSpan&) { return true; });
+                if (ok) loader->LogSummary();
+            });
+            BridgeThreadCapture() = nullptr;
+            finishMs += ElapsedMs(finishStart);
+        }
+
+        std::cout << capture.log.str();
+        capture.log.str(std::string());
+        if (!ok && error.empty()) error = CapturedError();
+        return ok ? &cache : nullptr;
+    }
+
+    const std::string& Error() const { return error; }
+
+    // Time the worker spent, the time callers blocked on it, and the time
+    // spent parsing the remaining blocks after it finished.
+    double LoadMs() const { return loadMs; }
+    double WaitMs() const { return waitMs; }
+    double FinishMs() const { return finishMs; }
+
+private:
+    void Join() {
+        if (worker.joinable()) worker.join();
+    }
+
+    // The collected "Error: ..." lines as one message.
+    std::string CapturedError() const {
+        std::istringstream lines(capture.errors.str());
+        std::string line, message;
+        while (std::getline(lines, line)) {
+            if (line.compare(0, 7, "Error: ") == 0) line.erase(0, 7);
+            if (line.empty()) continue;
+            if (!message.empty()) message += "; ";
+            message += line;
+        }
+        return message.empty() ? std::string("the cache could not be read") : message;
+    }
+
+    // Runs fn, turning anything it throws into a failed load: the worker has
+    // no caller to throw to, and Wait reports error like any other failure.
+    template <typename Fn>
+    void Guarded(Fn fn) {
+        try {
+            fn();
+        }
+        catch (const std::bad_alloc&) {
+            ok = false;
+            error = "out of memory";
+        }
+        catch (const std::exception& e) {
+            ok = false;
+            error = e.what();
+        }
+        catch (...) {
+            ok = false;
+            error = "unexpected failure while reading the cache";
+        }
+    }
+
+    void Load() {
+        BridgeThreadCapture() = &capture;
+        auto loadStart = std::chrono::steady_clock::now();
+        Guarded([this] { Read(); });
+        loadMs = ElapsedMs(loadStart);
+        BridgeThreadCapture() = nullptr;
+    }
+
+    void Read() {
+        ScopedPhase phase("cache_read");
+        if (source.path) {
+            BRIDGE_LOG("\n=== Loading data from file (background) ===");
+            if (!cache.mapping.Open(source.path)) {
+                BridgeErrorStream() << "Error: Could not open data file.\n";
+                ok = false;
+            }
+        }
+        else {
+            BRIDGE_LOG("\n=== Loading data from memory (background) ===");
+            cache.mapping.Borrow(source.data, source.size);
+        }
+
+        if (ok) {
+            phase.Count("bytes", cache.mapping.Size());
+            if (!HasCacheMagic(cache.mapping.Data(), cache.mapping.Size())) {
+                ok = LoadStreamCache(cache.mapping, cache.documentProperties, cache.geometryData);
+            }
+            else {
+                loader.reset(new IndexedCacheLoader(cache.mapping, cache.documentProperties, cache.geometryData));
+                ok = loader->Begin() && loader->LoadMeshes([this](const ByteSpan& name) {
+                    if (filter->Empty()) return true;
+                    std::string key(name.data, name.size);
+                    return filter->Selects(key, key);
+                });
+            }
+        }
+    }
+
+    CacheSource source;
+    const NameFilter* filter = nullptr;
+    LoadedCache cache;
+    std::unique_ptr<IndexedCacheLoader> loader;
+    std::thread worker;
+    BridgeLogCapture capture;
+    bool ok = true;
+    std::string error;
+    double loadMs = 0;
+    double waitMs = 0;
+    double finishMs = 0;
+};
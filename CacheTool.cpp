@@ -0,0 +1,76 @@
+﻿#include "CacheEdit.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// MAIN
+// ============================================================================
+//
+// Updates caches without re-extracting whole scenes. Builds from this file
+// and the shared headers alone, e.g.
+//   g++ -std=c++17 -O2 -pthread CacheTool.cpp -o cachetool
+
+int main(int argc, char** argv) {
+    PhaseTraceWriter traceWriter;
+    bool compactIds = false;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        if (ParseBridgeLogFlag(argc, argv, i)) continue;
+        if (std::strcmp(argv[i], "--compact-ids") == 0) {
+            compactIds = true;
+        }
+        else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    std::string command = args.empty() ? std::string() : args[0];
+    bool valid = (command == "diff" && args.size() == 3) || (command == "merge" && args.size() == 4) ||
+        (command == "compact" && args.size() == 3) || (command == "verify" && args.size() == 2);
+    if (!valid) {
+        std::cout << "Usage: cachetool [options] <command>\n";
+        std::cout << "  diff <a.dat> <b.dat>                    meshes and properties added, removed or changed\n";
+        std::cout << "                                          (exit code 0 same, 1 different, 2 error)\n";
+        std::cout << "  merge <base.dat> <partial.dat> <out.dat> meshes of partial replace or extend base\n";
+        std::cout << "  compact <in.dat> <out.dat>              rewrite, dropping unused shared payloads\n";
+        std::cout << "  verify <cache.dat>                      check the cache against its checksums\n";
+        std::cout << "                                          (exit code 0 intact, 1 corrupt, 2 error)\n";
+        std::cout << "  --compact-ids   run-length encode island IDs where it saves space (merge, compact)\n";
+        std::cout << "  --quiet         errors and the result only; --verbose adds per-item lines\n";
+        std::cout << "  --trace out.json  write phase timings as a Chrome trace\n";
+        return 2;
+    }
+
+    auto jobStart = std::chrono::steady_clock::now();
+    std::string error;
+    if (command == "diff") {
+        int result = RunCacheDiff(args[1], args[2], error);
+        if (result == 2) std::cerr << "Error: " << error << std::endl;
+        else std::cout << (result == 0 ? "Caches are identical.\n" : "Caches differ.\n");
+        return result;
+    }
+    if (command == "verify") {
+        int result = RunCacheVerify(args[1], std::cout, error);
+        if (result == 2) std::cerr << "Error: " << error << std::endl;
+        else std::cout << (result == 0 ? "Cache is intact.\n" : "Cache is corrupt.\n");
+        return result;
+    }
+
+    bool ok = command == "merge" ? RunCacheMerge(args[1], &args[2], args[3], compactIds, error)
+        : RunCacheMerge(args[1], nullptr, args[2], compactIds, error);
+    if (!ok) {
+        std::cerr << "Error: " << error << std::endl;
+        return 2;
+    }
+    std::chrono::duration<double, std::milli> jobMs = std::chrono::steady_clock::now() - jobStart;
+
+    std::cout << "\n============================================\n";
+    std::cout << "SUCCESS! Cache " << (command == "merge" ? "merge" : "compaction") << " finished.\n";
+    std::cout << "Time: " << jobMs.count() << " ms\n";
+    std::cout << "============================================\n";
+
+    return 0;
+}
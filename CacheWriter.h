@@ -0,0 +1,378 @@
+﻿#pragma once
+#include "CacheFormat.h"
+#include "IdCodec.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+// ============================================================================
+// Record encoding helpers
+// ============================================================================
+
+inline void WriteU32(std::string& out, uint32_t val) {
+    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+inline void WriteU64(std::string& out, uint64_t val) {
+    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+inline void WriteString(std::string& out, const std::string& str) {
+    uint32_t len = static_cast<uint32_t>(str.size());
+    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    if (len > 0) {
+        out.append(str.c_str(), len);
+    }
+}
+
+inline void WriteIntArray(std::string& out, const int* data, size_t size) {
+    uint32_t count = static_cast<uint32_t>(size);
+    out.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    if (count > 0) {
+        out.append(reinterpret_cast<const char*>(data), count * sizeof(int));
+    }
+}
+
+inline void WriteIntArray(std::string& out, const std::vector<int>& arr) {
+    WriteIntArray(out, arr.data(), arr.size());
+}
+
+// Island IDs as an 'I' record holds them: run-length encoded if compact is
+// set and that is smaller than the raw ints. Returns the record flags.
+inline uint8_t WriteIslandIds(std::string& out, const int* data, size_t count, bool compact) {
+    size_t rawStart = out.size();
+    if (compact) {
+        EncodeRleIds(out, data, count);
+        if (out.size() - rawStart < sizeof(uint32_t) + count * sizeof(int)) return kRecordFlagRleIds;
+        out.resize(rawStart);
+    }
+    out.reserve(rawStart + sizeof(uint32_t) + count * sizeof(int));
+    WriteIntArray(out, data, count);
+    return 0;
+}
+
+// ============================================================================
+// CACHE WRITER (v6 layout, see CacheFormat.h)
+// ============================================================================
+//
+// Records are assembled into two kCacheBufferSize buffers. When one fills
+// up, a flush thread writes it out while the caller fills the other; the
+// caller only waits if it catches up with the disk. Without async the
+// buffers are written inline, which produces the same bytes. Record
+// checksums are computed as records are appended, the file hash on the way
+// out, by the flush thread.
+//
+// Everything goes to path + ".tmp", renamed over path by Close, so a crash
+// or failed extraction never leaves a half-written cache behind. A writer
+// destroyed without a successful Close removes its temporary file.
+// OpenMemory collects the same bytes in a caller's buffer instead, for the
+// library API (RizomBridge.h).
+
+const size_t kCacheBufferSize = 1 << 20;
+
+// Replaces to with from in one step, also when to exists.
+inline bool MoveFileOver(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+class CacheWriter {
+public:
+    explicit CacheWriter(bool async = true) : async(async) {}
+    CacheWriter(const CacheWriter&) = delete;
+    CacheWriter& operator=(const CacheWriter&) = delete;
+    ~CacheWriter() { Abort(); }
+
+    bool Open(const char* path) {
+        finalPath = path;
+        tempPath = finalPath + ".tmp";
+        out.open(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+
+        filling.reserve(kCacheBufferSize);
+        flushing.reserve(kCacheBufferSize);
+        if (async) flusher = std::thread(&CacheWriter::FlushLoop, this);
+        WriteHeader();
+        return true;
+    }
+
+    // buffer receives the cache, complete once Close succeeds. Buffers are
+    // written out inline, a flush thread would only add a copy.
+    bool OpenMemory(std::vector<char>& buffer) {
+        memory = &buffer;
+        memory->clear();
+        async = false;
+        filling.reserve(kCacheBufferSize);
+        WriteHeader();
+        return true;
+    }
+
+    // Records written between BeginBlock and EndBlock are indexed under name.
+    void BeginBlock(char kind, const std::string& name) {
+        blockKind = kind;
+        blockName = name;
+        blockStart = offset;
+    }
+
+    void EndBlock() {
+        if (offset > blockStart) {
+            index.push_back({ blockKind, blockName, blockStart, offset - blockStart });
+        }
+    }
+
+    void WriteRecord(char marker, const std::string& body, uint8_t flags = 0) {
+        WriteRecord(marker, body.data(), body.size(), flags);
+    }
+
+    void WriteRecord(char marker, const char* body, size_t size, uint8_t flags = 0) {
+        CacheRecordHeader header = { marker, flags, static_cast<uint32_t>(size) };
+        uint32_t checksum = CacheRecordChecksum(header, body, size);
+        Append(&header, sizeof(header));
+        Append(body, size);
+        Append(&checksum, sizeof(checksum));
+    }
+
+    // Index of bytes in the blob table, adding them on first use. hash is
+    // their Xxh64Hash; equal hashes are compared byte for byte.
+    uint32_t AddBlob(uint64_t hash, const std::string& bytes) {
+        uint32_t blobIndex;
+        if (FindBlob(hash, bytes.data(), bytes.size(), blobIndex)) return blobIndex;
+        ownedBlobs.push_back(bytes);
+        return PushBlob(hash, ownedBlobs.back().data(), bytes.size());
+    }
+
+    // Same, without a copy: data must stay valid until Close, e.g. a blob of
+    // a mapped input cache.
+    uint32_t AddBlob(uint64_t hash, const char* data, size_t size) {
+        uint32_t blobIndex;
+        if (FindBlob(hash, data, size, blobIndex)) return blobIndex;
+        return PushBlob(hash, data, size);
+    }
+
+    size_t BlobCount() const { return blobs.size(); }
+
+    // Bytes written so far and how long the caller waited for the flush
+    // thread, for benchmarks.
+    uint64_t BytesWritten() const { return offset; }
+    double FlushWaitMs() const { return flushWaitMs; }
+
+    bool Close() {
+        if (!blobs.empty()) {
+            // Appended piecewise, so no blob is copied again on the way out.
+            BeginBlock(kIndexBlobs, std::string());
+            for (const Blob& blob : blobs) {
+                uint32_t size = static_cast<uint32_t>(blob.size);
+                CacheRecordHeader header = { 'B', 0, static_cast<uint32_t>(sizeof(blob.hash) + sizeof(size) + size) };
+                Xxh64 hash;
+                hash.Update(&header, sizeof(header));
+                hash.Update(&blob.hash, sizeof(blob.hash));
+                hash.Update(&size, sizeof(size));
+                hash.Update(blob.data, blob.size);
+                uint32_t checksum = static_cast<uint32_t>(hash.Digest());
+                Append(&header, sizeof(header));
+                Append(&blob.hash, sizeof(blob.hash));
+                Append(&size, sizeof(size));
+                Append(blob.data, blob.size);
+                Append(&checksum, sizeof(checksum));
+            }
+            EndBlock();
+        }
+
+        std::stable_sort(index.begin(), index.end(),
+            [](const IndexEntry& a, const IndexEntry& b) { return a.name < b.name; });
+
+        uint64_t indexOffset = offset;
+        std::string indexData;
+        for (const IndexEntry& entry : index) {
+            indexData.push_back(entry.kind);
+            WriteString(indexData, entry.name);
+            WriteU64(indexData, entry.offset);
+            WriteU64(indexData, entry.length);
+        }
+        Append(indexData.data(), indexData.size());
+        HandOff();
+        StopFlusher();
+
+        // Everything before the file hash has passed through WriteOut now.
+        CacheFooter footer = {};
+        footer.indexOffset = indexOffset;
+        footer.indexCount = static_cast<uint32_t>(index.size());
+        std::memcpy(footer.magic, kCacheFooterMagic, sizeof(footer.magic));
+        uint64_t digest = fileHash.Digest();
+        offset += sizeof(digest) + sizeof(footer);
+        if (memory) {
+            const char* digestBytes = reinterpret_cast<const char*>(&digest);
+            const char* footerBytes = reinterpret_cast<const char*>(&footer);
+            memory->insert(memory->end(), digestBytes, digestBytes + sizeof(digest));
+            memory->insert(memory->end(), footerBytes, footerBytes + sizeof(footer));
+            return true;
+        }
+        out.write(reinterpret_cast<const char*>(&digest), sizeof(digest));
+        out.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+        out.close();
+        if (failed || out.fail() || !MoveFileOver(tempPath, finalPath)) {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        tempPath.clear();
+        return true;
+    }
+
+private:
+    struct IndexEntry {
+        char kind;
+        std::string name;
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    struct Blob {
+        uint64_t hash;
+        const char* data;
+        size_t size;
+    };
+
+    bool FindBlob(uint64_t hash, const char* data, size_t size, uint32_t& blobIndex) const {
+        auto range = blobsByHash.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            const Blob& blob = blobs[it->second];
+            if (blob.size == size && std::memcmp(blob.data, data, size) == 0) {
+                blobIndex = it->second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t PushBlob(uint64_t hash, const char* data, size_t size) {
+        uint32_t blobIndex = static_cast<uint32_t>(blobs.size());
+        blobs.push_back({ hash, data, size });
+        blobsByHash.emplace(hash, blobIndex);
+        return blobIndex;
+    }
+
+    void Append(const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        offset += size;
+        while (size > 0) {
+            size_t count = std::min(size, kCacheBufferSize - filling.size());
+            filling.insert(filling.end(), bytes, bytes + count);
+            bytes += count;
+            size -= count;
+            if (filling.size() == kCacheBufferSize) HandOff();
+        }
+    }
+
+    // Passes the filled buffer to the flush thread, once it is done with the
+    // previous one, and continues in that previous one.
+    void HandOff() {
+        if (filling.empty()) return;
+        if (!async) {
+            WriteOut(filling);
+            filling.clear();
+            return;
+        }
+        auto waitStart = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex);
+        flushed.wait(lock, [this] { return !pending; });
+        flushWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+        filling.swap(flushing);
+        pending = true;
+        lock.unlock();
+        ready.notify_one();
+        filling.clear();
+    }
+
+    void FlushLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            ready.wait(lock, [this] { return pending || stopping; });
+            if (!pending) return;
+            lock.unlock();
+            WriteOut(flushing);
+            lock.lock();
+            pending = false;
+            flushed.notify_one();
+        }
+    }
+
+    void WriteHeader() {
+        CacheHeader header = {};
+        std::memcpy(header.magic, kCacheMagic, sizeof(header.magic));
+        header.version = kCacheVersion;
+        Append(&header, sizeof(header));
+    }
+
+    void WriteOut(const std::vector<char>& buffer) {
+        fileHash.Update(buffer.data(), buffer.size());
+        if (memory) {
+            memory->insert(memory->end(), buffer.begin(), buffer.end());
+            return;
+        }
+        out.write(buffer.data(), buffer.size());
+        if (out.fail()) failed = true;
+    }
+
+    void StopFlusher() {
+        if (!flusher.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        flusher.join();
+    }
+
+    void Abort() {
+        StopFlusher();
+        if (out.is_open()) out.close();
+        if (!tempPath.empty()) std::remove(tempPath.c_str());
+    }
+
+    bool async;
+    std::string finalPath, tempPath;
+    std::ofstream out;
+    std::vector<char>* memory = nullptr;  // OpenMemory's buffer
+    uint64_t offset = 0;
+    std::vector<IndexEntry> index;
+    std::vector<Blob> blobs;
+    std::deque<std::string> ownedBlobs;  // copies behind the string AddBlob
+    std::unordered_multimap<uint64_t, uint32_t> blobsByHash;
+    char blockKind = 0;
+    std::string blockName;
+    uint64_t blockStart = 0;
+    Xxh64 fileHash;  // updated by WriteOut only
+
+    std::vector<char> filling, flushing;
+    std::thread flusher;
+    std::mutex mutex;
+    std::condition_variable ready, flushed;
+    bool pending = false;
+    bool stopping = false;
+    std::atomic<bool> failed{ false };
+    double flushWaitMs = 0.0;
+};
@@ -0,0 +1,342 @@
+﻿#pragma once
+#include "BridgeLog.h"
+#include "CacheWriter.h"
+#include "Hash.h"
+#include "IdCodec.h"
+#include "NameFilter.h"
+#include "ParallelFor.h"
+#include "PropertyType.h"
+#include "Remap.h"
+#include "Topology.h"
+#include "UserData.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Extraction records
+// ============================================================================
+//
+// Shared by both extraction backends: the FBX SDK one in SdkExtract.h and
+// the native binary scanner in NativeExtract.h. A backend only fills in
+// snapshots; everything that decides what ends up in the cache lives here,
+// which is what keeps the two outputs byte-identical.
+
+struct ExtractOptions {
+    unsigned threadCount = 1;
+    bool compactIds = false;
+    bool native = false;
+    bool remapData = false;
+    NameFilter filter;  // meshes left out are never read
+};
+
+// --threads, --compact-ids, --remap-data, --native; i is advanced past a
+// value. Shared by the Extractor and the bridge library.
+inline bool ParseExtractFlag(int argc, const char* const* argv, int& i, ExtractOptions& options) {
+    std::string arg = argv[i];
+    if (arg == "--compact-ids") {
+        options.compactIds = true;
+    }
+    else if (arg == "--remap-data") {
+        options.remapData = true;
+    }
+    else if (arg == "--native") {
+        options.native = true;
+    }
+    else if (arg == "--threads" && i + 1 < argc) {
+        options.threadCount = ThreadCountArg(argv[++i]);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// One property value, copied out of the source so it can be encoded anywhere.
+// bytes holds the value as the cache stores it (PropertyType.h); type stays
+// kPropertyNone for types the cache cannot hold, named by typeName.
+struct PropertySnapshot {
+    std::string propName;
+    std::string typeName;
+    PropertyType type = kPropertyNone;
+    std::string bytes;
+};
+
+// shared, when set, is a value that goes to the blob table: the body still
+// lacks it, and WriteEncodedRecord appends its table index.
+struct EncodedRecord {
+    char marker;
+    uint8_t flags;
+    std::string body;
+    const std::string* shared = nullptr;
+    uint64_t sharedHash = 0;
+};
+
+// False, with nothing encoded, if the property's type has no cache tag.
+inline bool EncodeProperty(EncodedRecord& record, const PropertySnapshot& snap,
+    const std::string& objectName, std::ostream& log) {
+    BRIDGE_LOG_ITEM_TO(log, "Found property '" << snap.propName << "' on object: " << objectName);
+    if (snap.type == kPropertyNone) {
+        // One write, as meshes are encoded concurrently.
+        std::cerr << ("Warning: Skipping property '" + snap.propName + "' on " + objectName +
+            ": unsupported type '" + snap.typeName + "'\n");
+        return false;
+    }
+
+    const char* typeName = GetPropertyTypeInfo(snap.type).name;
+    std::string& body = record.body;
+    WriteString(body, objectName);
+    WriteString(body, snap.propName);
+    body.push_back(static_cast<char>(snap.type));
+    record.flags |= kRecordFlagTypeTag;
+
+    if (PropertyValueSize(snap.type) != 0) {
+        body.append(snap.bytes);
+        BRIDGE_LOG_ITEM_TO(log, " -> Saved " << snap.bytes.size() << " bytes (" << typeName << ").");
+    }
+    else if (snap.bytes.size() >= kSharedBlobMinSize) {
+        record.shared = &snap.bytes;
+        record.sharedHash = Xxh64Hash(snap.bytes.data(), snap.bytes.size());
+        BRIDGE_LOG_ITEM_TO(log, " -> Shared " << snap.bytes.size() << " bytes (" << typeName << ").");
+    }
+    else {
+        WriteString(body, snap.bytes);
+        BRIDGE_LOG_ITEM_TO(log, " -> Saved " << snap.bytes.size() << " bytes (" << typeName << ").");
+    }
+    return true;
+}
+
+inline void WriteEncodedRecord(CacheWriter& outFile, EncodedRecord& record) {
+    if (record.shared) {
+        WriteU32(record.body, outFile.AddBlob(record.sharedHash, *record.shared));
+        record.flags |= kRecordFlagBlobRef;
+        record.shared = nullptr;
+    }
+    outFile.WriteRecord(record.marker, record.body, record.flags);
+}
+
+// ============================================================================
+// Document block
+// ============================================================================
+
+// properties are RizomUV and its Scene/UVSets/UVMap/RootGroup children, in
+// that order, as far as they exist.
+inline void WriteDocumentBlock(CacheWriter& outFile, const std::vector<PropertySnapshot>& properties) {
+    ScopedPhase phase("write_document");
+    phase.Count("properties", properties.size());
+    outFile.BeginBlock(kIndexDocument, "FbxDocument");
+    for (const PropertySnapshot& prop : properties) {
+        EncodedRecord record = { 'G', 0, std::string() };
+        if (EncodeProperty(record, prop, "FbxDocument", std::cout)) WriteEncodedRecord(outFile, record);
+    }
+    outFile.EndBlock();
+    BRIDGE_LOG("  Document: " << properties.size() << " RizomUV properties");
+}
+
+// ============================================================================
+// Mesh blocks
+// ============================================================================
+
+// data points at count values of type, owned by the backend (SDK lock or
+// storage). typeName is the backend's, for the warning when type is not one
+// user data can hold.
+struct UserDataArraySnapshot {
+    std::string name;
+    std::string typeName;
+    PropertyType type = kPropertyNone;
+    const void* data = nullptr;
+    size_t count = 0;
+    std::vector<char> storage;
+};
+
+// One user data element (UserData.h) and its direct arrays.
+struct UserDataSnapshot {
+    std::string name;
+    uint32_t layer = 0;
+    uint8_t mapping = kMappingNone;
+    uint8_t reference = kReferenceDirect;
+    std::vector<UserDataArraySnapshot> arrays;
+};
+
+// polygonVertices, when set, holds topology.polygonVertexCount indices the
+// encode thread hashes into topology.indexHash. With polygonSizes and
+// points also set, it samples the polygons too; a backend can instead fill
+// samples itself.
+struct MeshSnapshot {
+    std::string nodeName;
+    std::string meshName;
+    std::vector<PropertySnapshot> properties;
+    std::vector<UserDataSnapshot> userData;
+    TopologyFingerprint topology;
+    const int* polygonVertices = nullptr;
+    bool hasTopology = false;
+
+    std::vector<int> polygonSizes;
+    const double* points = nullptr;
+    size_t pointStride = 0;
+    size_t pointCount = 0;
+    std::vector<PolygonSample> samples;
+    bool hasSamples = false;
+};
+
+// Only island IDs and other user data arrays are remapped, so only meshes
+// with some are sampled.
+inline bool HasRizomUserData(const MeshSnapshot& snap) {
+    for (const UserDataSnapshot& userData : snap.userData) {
+        if (IsRizomUserData(userData.name) && !userData.arrays.empty()) return true;
+    }
+    return false;
+}
+
+// Only meshes with something to inject get a fingerprint: an edit to any
+// other mesh is not a mismatch.
+inline bool CarriesRizomData(const MeshSnapshot& snap) {
+    return !snap.properties.empty() || HasRizomUserData(snap);
+}
+
+struct EncodedMesh {
+    std::vector<EncodedRecord> records;
+    std::ostringstream log;  // per-item lines, printed in mesh order
+    uint64_t valueCount = 0;
+};
+
+// One 'U' record per array, copied in one piece; int arrays go through
+// WriteIslandIds so --compact-ids applies to them. Arrays of an unsupported
+// type are skipped with a warning, like properties.
+inline void EncodeUserData(const UserDataSnapshot& userData, const std::string& cacheName, bool compactIds,
+    EncodedMesh& encoded) {
+    for (const UserDataArraySnapshot& array : userData.arrays) {
+        if (!IsUserDataType(array.type)) {
+            std::cerr << ("Warning: Skipping user data array '" + array.name + "' of '" + userData.name + "' on " +
+                cacheName + ": unsupported type '" + array.typeName + "'\n");
+            continue;
+        }
+        encoded.records.push_back({ 'U', 0, std::string() });
+        EncodedRecord& record = encoded.records.back();
+        std::string& body = record.body;
+        size_t count = array.data ? array.count : 0;
+        WriteString(body, cacheName);
+        WriteString(body, userData.name);
+        WriteU32(body, userData.layer);
+        body.push_back(static_cast<char>(userData.mapping));
+        body.push_back(static_cast<char>(userData.reference));
+        WriteString(body, array.name);
+        body.push_back(static_cast<char>(array.type));
+        if (array.type == kPropertyInt) {
+            record.flags |= WriteIslandIds(body, static_cast<const int*>(array.data), count, compactIds);
+        }
+        else {
+            WriteU32(body, static_cast<uint32_t>(count));
+            if (count > 0) body.append(static_cast<const char*>(array.data), count * PropertyValueSize(array.type));
+        }
+        encoded.valueCount += count;
+        BRIDGE_LOG_ITEM_TO(encoded.log, " >>> Saved '" << array.name << "': " << count << " "
+            << GetPropertyTypeInfo(array.type).name << " values, layer " << userData.layer << " <<<");
+    }
+}
+
+inline void EncodeMesh(const MeshSnapshot& snap, bool compactIds, EncodedMesh& encoded) {
+    std::ostream& log = encoded.log;
+    BRIDGE_LOG_ITEM_TO(log, "\nChecking node: " << snap.nodeName << " (mesh: " << snap.meshName << ")");
+
+    const std::string& cacheName = snap.nodeName;
+    BRIDGE_LOG_ITEM_TO(log, "Processing geometry: " << cacheName);
+
+    // === Part 1: Property RizomUV ===
+    for (const PropertySnapshot& prop : snap.properties) {
+        encoded.records.push_back({ 'M', 0, std::string() });
+        if (!EncodeProperty(encoded.records.back(), prop, cacheName, log)) encoded.records.pop_back();
+    }
+
+    // === Part 2: User data (island group IDs and anything else RizomUV stores) ===
+    for (const UserDataSnapshot& userData : snap.userData) {
+        BRIDGE_LOG_ITEM_TO(log, " Found UserData: '" << userData.name << "'");
+
+        if (IsRizomUserData(userData.name)) {
+            BRIDGE_LOG_ITEM_TO(log, " >>> Extracting UserData (contains RizomUV/Island/GroupID) <<<");
+            EncodeUserData(userData, cacheName, compactIds, encoded);
+        }
+    }
+
+    // === Part 3: Topology fingerprint ===
+    // Skipped when no property or array made it into a record.
+    bool hasUserDataRecords = std::any_of(encoded.records.begin(), encoded.records.end(),
+        [](const EncodedRecord& record) { return record.marker == 'U'; });
+    if (snap.hasTopology && !encoded.records.empty()) {
+        TopologyFingerprint topology = snap.topology;
+        if (snap.polygonVertices) {
+            topology.indexHash = HashPolygonVertices(snap.polygonVertices, topology.polygonVertexCount);
+        }
+        encoded.records.push_back({ 'T', 0, std::string() });
+        std::string& body = encoded.records.back().body;
+        WriteString(body, cacheName);
+        uint32_t header[3] = { topology.polygonCount, topology.polygonVertexCount,
+            static_cast<uint32_t>(kTopologySizeBins) };
+        body.append(reinterpret_cast<const char*>(header), sizeof(header));
+        body.append(reinterpret_cast<const char*>(topology.sizeBins), sizeof(topology.sizeBins));
+        WriteU64(body, topology.indexHash);
+        BRIDGE_LOG_ITEM_TO(log, " Topology: " << topology.polygonCount << " polygons, hash " << std::hex
+            << topology.indexHash << std::dec);
+    }
+
+    // === Part 4: Polygon samples for remapping ===
+    // Only 'U' records are remapped; a mesh without them needs no samples.
+    if (!hasUserDataRecords) return;
+    std::vector<PolygonSample> computed;
+    const std::vector<PolygonSample>* samples = snap.hasSamples ? &snap.samples : nullptr;
+    if (!samples && snap.points && snap.polygonVertices && !snap.polygonSizes.empty()) {
+        PolygonSampler sampler(snap.points, snap.pointStride, snap.pointCount);
+        if (SamplePolygons(sampler, snap.polygonVertices, snap.topology.polygonVertexCount,
+            snap.polygonSizes.data(), snap.polygonSizes.size(), computed)) {
+            samples = &computed;
+        }
+    }
+    if (samples) {
+        encoded.records.push_back({ 'P', 0, std::string() });
+        std::string& body = encoded.records.back().body;
+        WriteString(body, cacheName);
+        uint32_t count = static_cast<uint32_t>(samples->size());
+        body.append(reinterpret_cast<const char*>(&count), sizeof(count));
+        body.append(reinterpret_cast<const char*>(samples->data()), samples->size() * sizeof(PolygonSample));
+        BRIDGE_LOG_ITEM_TO(log, " Polygon samples: " << count);
+    }
+}
+
+// Encodes meshes on threadCount threads and writes them in snapshot order,
+// so the output is identical for every thread count.
+inline void WriteMeshBlocks(CacheWriter& outFile, const std::vector<MeshSnapshot>& meshes,
+    unsigned threadCount, bool compactIds) {
+    std::vector<EncodedMesh> encoded(meshes.size());
+    {
+        ScopedPhase phase("encode_meshes");
+        phase.Count("meshes", meshes.size());
+        ParallelFor(meshes.size(), threadCount, [&](size_t i) {
+            ScopedPhase meshPhase("encode_mesh", meshes[i].nodeName);
+            EncodeMesh(meshes[i], compactIds, encoded[i]);
+            meshPhase.Count("values", encoded[i].valueCount);
+        });
+    }
+
+    ScopedPhase phase("write_meshes");
+    uint64_t valueCount = 0;
+    size_t blockCount = 0;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        if (BridgeItemLogEnabled()) std::cout << encoded[i].log.str();
+        valueCount += encoded[i].valueCount;
+        if (encoded[i].records.empty()) continue;  // nothing to inject, no block
+        blockCount++;
+        outFile.BeginBlock(kIndexMesh, meshes[i].nodeName);
+        for (EncodedRecord& record : encoded[i].records) {
+            WriteEncodedRecord(outFile, record);
+        }
+        outFile.EndBlock();
+        encoded[i].records.clear();
+        encoded[i].records.shrink_to_fit();
+    }
+    phase.Count("values", valueCount);
+    phase.Count("blobs", outFile.BlobCount());
+    BRIDGE_LOG("  Meshes: " << blockCount << " blocks, " << valueCount << " user data values, "
+        << outFile.BlobCount() << " shared payloads");
+}
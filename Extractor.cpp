@@ -1,236 +1,121 @@
 ﻿#include <fbxsdk.h>
+#include "SdkExtract.h"
+#include "BridgeJobs.h"
 #include <iostream>
-#include <fstream>
 #include <vector>
-#include <map>
 #include <string>
-#include <cstdint>
+#include <cstring>
+#include <chrono>
 
 // ============================================================================
-// HELPERS
+// MAIN
 // ============================================================================
 
-void WriteString(std::ofstream& out, const std::string& str) {
-    uint32_t len = static_cast<uint32_t>(str.size());
-    out.write(reinterpret_cast<const char*>(&len), sizeof(len));
-    if (len > 0) {
-        out.write(str.c_str(), len);
-    }
-}
-
-void WriteBlob(std::ofstream& out, const FbxBlob& blob) {
-    uint32_t size = static_cast<uint32_t>(blob.Size());
-    out.write(reinterpret_cast<const char*>(&size), sizeof(size));
-    if (size > 0) {
-        out.write(static_cast<const char*>(blob.Access()), size);
+int main(int argc, char** argv) {
+    PhaseTraceWriter traceWriter;
+    ExtractOptions options;
+    bool serve = false;
+    std::string manifestPath, summaryPath;
+    unsigned jobCount = 1;
+    std::vector<const char*> paths;
+    std::string filterError;
+    for (int i = 1; i < argc; i++) {
+        if (ParseBridgeLogFlag(argc, argv, i)) continue;
+        if (ParseNameFilterFlag(argc, argv, i, options.filter, filterError)) continue;
+        if (ParseExtractFlag(argc, argv, i, options)) continue;
+        if (std::strcmp(argv[i], "--serve") == 0) {
+            serve = true;
+        }
+        else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            manifestPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobCount = ThreadCountArg(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--summary") == 0 && i + 1 < argc) {
+            summaryPath = argv[++i];
+        }
+        else {
+            paths.push_back(argv[i]);
+        }
     }
-}
 
-void WriteIntArray(std::ofstream& out, const std::vector<int>& arr) {
-    uint32_t count = static_cast<uint32_t>(arr.size());
-    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
-    if (count > 0) {
-        out.write(reinterpret_cast<const char*>(arr.data()), count * sizeof(int));
+    if (!filterError.empty()) {
+        std::cerr << "Error: " << filterError << std::endl;
+        return 1;
     }
-}
-
-void ProcessAndWriteProperty(std::ofstream& outFile, const FbxProperty& prop,
-    const std::string& objectName, char marker) {
-    std::string propName = prop.GetName().Buffer();
-    std::cout << "Found property '" << propName << "' on object: " << objectName << std::endl;
-    outFile.write(&marker, sizeof(marker));
-    WriteString(outFile, objectName);
-    WriteString(outFile, propName);
-    std::string typeName = prop.GetPropertyDataType().GetName();
-    WriteString(outFile, typeName);
 
-    if (prop.GetPropertyDataType().Is(FbxIntDT)) {
-        int val = prop.Get<int>();
-        outFile.write(reinterpret_cast<const char*>(&val), sizeof(val));
-        std::cout << " -> Saved " << sizeof(val) << " bytes (Int)." << std::endl;
-    }
-    else if (prop.GetPropertyDataType().Is(FbxBlobDT)) {
-        FbxBlob val = prop.Get<FbxBlob>();
-        WriteBlob(outFile, val);
-        std::cout << " -> Saved " << val.Size() << " bytes (Blob)." << std::endl;
-    }
-    else if (prop.GetPropertyDataType().Is(FbxStringDT) ||
-        prop.GetPropertyDataType().Is(FbxUrlDT)) {
-        FbxString val = prop.Get<FbxString>();
-        WriteString(outFile, val.Buffer());
-        std::cout << " -> Saved " << val.GetLen() << " bytes (String)." << std::endl;
+    if (paths.size() < 2 && !serve && manifestPath.empty()) {
+        std::cout << "Usage: program.exe [options] <input.fbx> <output.dat> [filter file]\n";
+        std::cout << "       program.exe [options] --serve\n";
+        std::cout << "       program.exe [options] --batch <manifest|-> [--jobs N] [--summary out.json]\n";
+        std::cout << "  --threads N     encode meshes on N threads (0 = all cores, default 1)\n";
+        std::cout << "  --compact-ids   run-length encode island IDs where it saves space\n";
+        std::cout << "  --remap-data    store polygon centroids/normals so IDs can be remapped onto edited meshes\n";
+        std::cout << "  --native        scan binary FBX directly instead of importing it with the SDK\n";
+        std::cout << "  --include P, --exclude P  only meshes whose node or mesh name matches (glob, or re:regex)\n";
+        std::cout << "  --filter-file F  patterns, one per line (!pattern excludes)\n";
+        std::cout << "  --batch         run every <input.fbx>\\t<output.dat>[\\t<filter file>] line of the manifest\n";
+        std::cout << "  --jobs N        files processed concurrently in batch mode (0 = all cores)\n";
+        std::cout << "  --quiet         errors and the result only; --verbose adds per-item lines\n";
+        std::cout << "  --trace out.json  write phase timings as a Chrome trace\n";
+        return 1;
     }
-}
 
-// ============================================================================
-// EXTRACTION from FbxDocument
-// ============================================================================
-
-void ExtractDocumentRizomData(FbxScene* scene, std::ofstream& outFile) {
-    std::cout << "\n=== Extracting RizomUV data from FbxDocument ===" << std::endl;
-    FbxDocument* rootDocument = scene->GetRootDocument();
-    if (!rootDocument) return;
-
-    FbxProperty rizomProp = rootDocument->FindProperty("RizomUV");
-    if (rizomProp.IsValid()) {
-        ProcessAndWriteProperty(outFile, rizomProp, "FbxDocument", 'G');
-
-        FbxProperty sceneProp = rizomProp.Find("Scene");
-        if (sceneProp.IsValid()) {
-            ProcessAndWriteProperty(outFile, sceneProp, "FbxDocument", 'G');
-        }
-
-        FbxProperty uvSetsProp = rizomProp.Find("UVSets");
-        if (uvSetsProp.IsValid()) {
-            ProcessAndWriteProperty(outFile, uvSetsProp, "FbxDocument", 'G');
-
-            FbxProperty uvMapProp = uvSetsProp.Find("UVMap");
-            if (uvMapProp.IsValid()) {
-                ProcessAndWriteProperty(outFile, uvMapProp, "FbxDocument", 'G');
-
-                FbxProperty rootGroupProp = uvMapProp.Find("RootGroup");
-                if (rootGroupProp.IsValid()) {
-                    ProcessAndWriteProperty(outFile, rootGroupProp, "FbxDocument", 'G');
-                }
-            }
-        }
+    // An optional third field names a filter file for that job alone.
+    BridgeJobFn job = [&options](FbxManager* manager, const std::vector<std::string>& args, std::string& error) {
+        if (args.size() < 3) return RunExtraction(manager, args[0].c_str(), args[1].c_str(), options, error);
+        ExtractOptions jobOptions = options;
+        if (!jobOptions.filter.LoadFile(args[2], error)) return 1;
+        return RunExtraction(manager, args[0].c_str(), args[1].c_str(), jobOptions, error);
+    };
+    const char* jobUsage = "<input.fbx>\\t<output.dat>[\\t<filter file>]";
+
+    if (!manifestPath.empty()) {
+        return RunBatch(manifestPath, jobCount, summaryPath, "extractor", 2, jobUsage, job, 1);
     }
-}
-
-// ============================================================================
-// EXTRACTION FROM GEOMETRY
-// ============================================================================
-
-void ExtractGeometryRizomData(FbxScene* scene, std::ofstream& outFile) {
-    std::cout << "\n=== Extracting RizomUV data from Geometries ===" << std::endl;
 
-    int nodeCount = scene->GetNodeCount();
-    for (int i = 0; i < nodeCount; i++) {
-        FbxNode* node = scene->GetNode(i);
-        FbxNodeAttribute* attr = node->GetNodeAttribute();
-
-        if (attr && attr->GetAttributeType() == FbxNodeAttribute::eMesh) {
-            FbxMesh* mesh = node->GetMesh();
-
-            
-            std::string nodeName = node->GetName();
-            std::string meshName = mesh->GetName();
-
-            std::cout << "\nChecking node: " << nodeName << " (mesh: " << meshName << ")" << std::endl;
-
-            
-            std::string cacheName = nodeName;
-            std::cout << "Processing geometry: " << cacheName << std::endl;
-
-            // === Part 1: Property RizomUV ===
-            FbxProperty rizomProp = mesh->FindProperty("RizomUV");
-            if (rizomProp.IsValid()) {
-                ProcessAndWriteProperty(outFile, rizomProp, cacheName, 'M');
-            }
-
-            FbxProperty uvSetsProp = mesh->FindProperty("RizomUVUVSets");
-            if (uvSetsProp.IsValid()) {
-                ProcessAndWriteProperty(outFile, uvSetsProp, cacheName, 'M');
-            }
-
-            // === Part 2: Island Group IDs ===
-            int layerCount = mesh->GetLayerCount();
-            for (int layerIndex = 0; layerIndex < layerCount; layerIndex++) {
-                FbxLayer* layer = mesh->GetLayer(layerIndex);
-                FbxLayerElementUserData* userData = layer->GetUserData();
-
-                if (userData) {
-                    std::string userDataName = userData->GetName();
-                    std::cout << " Found UserData: '" << userDataName << "'" << std::endl;
-
-                    bool isRizomData = (userDataName.find("Island") != std::string::npos) ||
-                        (userDataName.find("RizomUV") != std::string::npos) ||
-                        (userDataName.find("GroupID") != std::string::npos);
-
-                    if (isRizomData) {
-                        std::cout << " >>> Extracting UserData (contains RizomUV/Island/GroupID) <<<" << std::endl;
-
-                        char marker = 'I';
-                        outFile.write(&marker, sizeof(marker));
-                        WriteString(outFile, cacheName);  
-                        WriteString(outFile, userDataName);
-
-                        std::vector<int> groupIDs;
-                        int arrayCount = userData->GetDirectArrayCount();
-
-                        if (arrayCount > 0) {
-                            bool getStatus = false;
-                            FbxLayerElementArrayTemplate<void*>* voidArray = userData->GetDirectArrayVoid(0, &getStatus);
-
-                            if (getStatus && voidArray) {
-                                int elementCount = voidArray->GetCount();
-                                int* dataPtr = (int*)voidArray->GetLocked(FbxLayerElementArray::eReadLock);
-
-                                if (dataPtr) {
-                                    for (int k = 0; k < elementCount; k++) {
-                                        groupIDs.push_back(dataPtr[k]);
-                                    }
-                                    voidArray->Release((void**)&dataPtr);
-                                }
-                            }
-                        }
-
-                        if (!groupIDs.empty()) {
-                            WriteIntArray(outFile, groupIDs);
-                            std::cout << " >>> Saved " << groupIDs.size() << " Island Group IDs <<<" << std::endl;
-                        }
-                        else {
-                            WriteIntArray(outFile, groupIDs);
-                        }
-                    }
-                }
-            }
+    // The native backend never touches the SDK, so one-shot runs skip it.
+    if (options.native && !serve) {
+        auto jobStart = std::chrono::steady_clock::now();
+        std::string error;
+        if ((paths.size() > 2 && !options.filter.LoadFile(paths[2], error)) ||
+            RunNativeExtraction(paths[0], paths[1], options, error) != 0) {
+            std::cerr << error << std::endl;
+            return 1;
         }
+        std::cout << "\nSUCCESS! Native extraction finished in " << ElapsedMs(jobStart) << " ms\n";
+        return 0;
     }
-}
-
-// ============================================================================
-// MAIN
-// ============================================================================
-
-int main(int argc, char** argv) {
-    if (argc < 3) {
-        std::cout << "Usage: program.exe <input.fbx> <output.dat>\n";
-        return 1;
-    }
-
-    const char* inputFBX = argv[1];
-    const char* outputDAT = argv[2];
 
-    FbxManager* manager = FbxManager::Create();
-    FbxIOSettings* ios = FbxIOSettings::Create(manager, IOSROOT);
-    manager->SetIOSettings(ios);
+    auto initStart = std::chrono::steady_clock::now();
+    ScopedPhase initPhase("sdk_init");
+    FbxManager* manager = CreateBridgeManager();
+    initPhase.Stop();
+    double initMs = ElapsedMs(initStart);
 
-    FbxImporter* importer = FbxImporter::Create(manager, "");
-    if (!importer->Initialize(inputFBX, -1, manager->GetIOSettings())) {
-        std::cerr << "Could not open FBX file: " << importer->GetStatus().GetErrorString() << std::endl;
-        return 1;
+    if (serve) {
+        int result = RunServer(manager, initMs, 2, jobUsage, job, 1);
+        manager->Destroy();
+        return result;
     }
 
-    FbxScene* scene = FbxScene::Create(manager, "Scene");
-    importer->Import(scene);
-    importer->Destroy();
-
-    std::ofstream outFile(outputDAT, std::ios::binary);
-    if (!outFile.is_open()) {
-        std::cerr << "Could not open output file: " << outputDAT << std::endl;
+    auto jobStart = std::chrono::steady_clock::now();
+    std::string error;
+    if ((paths.size() > 2 && !options.filter.LoadFile(paths[2], error)) ||
+        RunExtraction(manager, paths[0], paths[1], options, error) != 0) {
+        std::cerr << error << std::endl;
+        manager->Destroy();
         return 1;
     }
+    double jobMs = ElapsedMs(jobStart);
 
-    ExtractDocumentRizomData(scene, outFile);
-    ExtractGeometryRizomData(scene, outFile);
-
-    outFile.close();
     manager->Destroy();
 
-    std::cout << "\n============================================" << std::endl;
-    std::cout << "SUCCESS! Complete extraction finished." << std::endl;
-    std::cout << "============================================" << std::endl;
+    std::cout << "\n============================================\n";
+    std::cout << "SUCCESS! Complete extraction finished.\n";
+    std::cout << "SDK init: " << initMs << " ms, extraction: " << jobMs << " ms\n";
+    std::cout << "============================================\n";
 
     return 0;
 }
\ No newline at end of file
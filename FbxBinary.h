@@ -0,0 +1,575 @@
+﻿#pragma once
+#include "MappedFile.h"
+#include "Inflate.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Binary FBX node records
+// ============================================================================
+//
+// Minimal reader/writer for the binary FBX container (7.x), enough to patch
+// a file without the SDK:
+//
+//   header   : "Kaydara FBX Binary  \0" 0x1A 0x00 | uint32 version
+//   node     : endOffset | propertyCount | propertyListLength | uint8 nameLength
+//              | name | properties | children... | null record
+//   footer   : footer id (16) | zero padding to 16 | version | 120 zeros | magic (16)
+//
+// endOffset/propertyCount/propertyListLength are uint32 before 7500 and
+// uint64 from 7500 on; the null record is a header of all zeros. endOffset
+// is absolute, so inserting anything means rewriting every later header.
+//
+// Parsing keeps property payloads as spans into the source mapping. Writing
+// recomputes all headers and copies those spans through unchanged.
+// FbxRecordScanner reads the same records without building a tree.
+
+const char kFbxBinaryMagic[23] = "Kaydara FBX Binary  \0\x1a";
+const size_t kFbxBinaryHeaderSize = 27;
+const size_t kFbxFooterTailSize = 4 + 120 + 16;
+
+// Checks the magic and reads the version of a binary FBX file.
+inline bool ReadFbxBinaryHeader(const char* base, size_t size, uint32_t& version, std::string& error) {
+    if (size < kFbxBinaryHeaderSize || std::memcmp(base, kFbxBinaryMagic, sizeof(kFbxBinaryMagic)) != 0) {
+        error = "not a binary FBX file";
+        return false;
+    }
+    std::memcpy(&version, base + 23, sizeof(version));
+    if (version < 7000 || version >= 8000) {
+        error = "unsupported FBX version " + std::to_string(version);
+        return false;
+    }
+    return true;
+}
+
+struct FbxNodeRecord {
+    std::string name;
+    uint64_t propertyCount = 0;
+    ByteSpan sourceProperties;    // span into the parsed file
+    std::string ownedProperties;  // used instead for new or rewritten nodes
+    bool ownsProperties = false;
+    std::vector<FbxNodeRecord> children;
+    bool hasNullRecord = false;
+
+    ByteSpan Properties() const {
+        if (!ownsProperties) return sourceProperties;
+        ByteSpan span;
+        span.data = ownedProperties.data();
+        span.size = ownedProperties.size();
+        return span;
+    }
+
+    FbxNodeRecord* FindChild(const char* childName) {
+        for (FbxNodeRecord& child : children) {
+            if (child.name == childName) return &child;
+        }
+        return nullptr;
+    }
+
+    void SetProperties(std::string data, uint64_t count) {
+        ownedProperties = std::move(data);
+        ownsProperties = true;
+        propertyCount = count;
+    }
+
+    // Invalidates pointers to existing children.
+    FbxNodeRecord& AddChild(const char* childName) {
+        hasNullRecord = true;
+        children.emplace_back();
+        children.back().name = childName;
+        return children.back();
+    }
+};
+
+// ============================================================================
+// Property lists
+// ============================================================================
+
+struct FbxPropertyValue {
+    char type = 0;
+    int64_t integer = 0;   // Y C I L
+    double real = 0.0;     // F D
+    ByteSpan data;         // S R: bytes; arrays: payload as stored
+    uint32_t arrayLength = 0;
+    uint32_t encoding = 0; // arrays: 0 raw, 1 zlib
+};
+
+struct FbxPropertyCursor {
+    const char* pos;
+    const char* end;
+
+    explicit FbxPropertyCursor(const ByteSpan& properties)
+        : pos(properties.data), end(properties.data + properties.size) {}
+
+    explicit FbxPropertyCursor(const FbxNodeRecord& node)
+        : FbxPropertyCursor(node.Properties()) {}
+
+    template <typename T>
+    bool ReadPod(T& val) {
+        if (static_cast<size_t>(end - pos) < sizeof(T)) return false;
+        std::memcpy(&val, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    bool Next(FbxPropertyValue& value) {
+        if (pos >= end) return false;
+        value = FbxPropertyValue();
+        value.type = *pos++;
+        switch (value.type) {
+        case 'Y': { int16_t v; if (!ReadPod(v)) return false; value.integer = v; return true; }
+        case 'C': { int8_t v; if (!ReadPod(v)) return false; value.integer = v; return true; }
+        case 'I': { int32_t v; if (!ReadPod(v)) return false; value.integer = v; return true; }
+        case 'L': { int64_t v; if (!ReadPod(v)) return false; value.integer = v; return true; }
+        case 'F': { float v; if (!ReadPod(v)) return false; value.real = v; return true; }
+        case 'D': { double v; if (!ReadPod(v)) return false; value.real = v; return true; }
+        case 'S':
+        case 'R': {
+            uint32_t len;
+            if (!ReadPod(len) || static_cast<size_t>(end - pos) < len) return false;
+            value.data.data = pos;
+            value.data.size = len;
+            pos += len;
+            return true;
+        }
+        case 'f': case 'd': case 'l': case 'i': case 'b': {
+            uint32_t compressedLength;
+            if (!ReadPod(value.arrayLength) || !ReadPod(value.encoding) || !ReadPod(compressedLength)) return false;
+            if (static_cast<size_t>(end - pos) < compressedLength) return false;
+            value.data.data = pos;
+            value.data.size = compressedLength;
+            pos += compressedLength;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+};
+
+// Reads the index-th property of a list; false if it is missing or malformed.
+inline bool GetFbxProperty(const ByteSpan& properties, size_t index, FbxPropertyValue& value) {
+    FbxPropertyCursor cursor(properties);
+    for (size_t i = 0; i <= index; i++) {
+        if (!cursor.Next(value)) return false;
+    }
+    return true;
+}
+
+inline bool GetFbxProperty(const FbxNodeRecord& node, size_t index, FbxPropertyValue& value) {
+    return GetFbxProperty(node.Properties(), index, value);
+}
+
+inline std::string FbxPropertyString(const FbxPropertyValue& value) {
+    return std::string(value.data.data, value.data.size);
+}
+
+// Object names are stored as "Name\x00\x01Class".
+inline std::string FbxObjectName(const FbxPropertyValue& value) {
+    std::string name = FbxPropertyString(value);
+    size_t separator = name.find(std::string("\x00\x01", 2));
+    return separator == std::string::npos ? name : name.substr(0, separator);
+}
+
+// Decodes a 'b' array (raw or zlib) into count bytes.
+inline bool ReadFbxArray8(const FbxPropertyValue& value, void* dst) {
+    if (value.type != 'b') return false;
+    size_t size = value.arrayLength;
+    if (value.encoding == 0) {
+        if (value.data.size != size) return false;
+        if (size > 0) std::memcpy(dst, value.data.data, size);
+        return true;
+    }
+    return value.encoding == 1 && ZlibInflater::Inflate(value.data.data, value.data.size, dst, size);
+}
+
+// Decodes an 'i' or 'f' array (raw or zlib) into count 32-bit values.
+inline bool ReadFbxArray32(const FbxPropertyValue& value, void* dst) {
+    if (value.type != 'i' && value.type != 'f') return false;
+    size_t size = static_cast<size_t>(value.arrayLength) * 4;
+    if (value.encoding == 0) {
+        if (value.data.size != size) return false;
+        if (size > 0) std::memcpy(dst, value.data.data, size);
+        return true;
+    }
+    return value.encoding == 1 && ZlibInflater::Inflate(value.data.data, value.data.size, dst, size);
+}
+
+// Decodes a 'd' or 'l' array (raw or zlib) into count 64-bit values.
+inline bool ReadFbxArray64(const FbxPropertyValue& value, void* dst) {
+    if (value.type != 'd' && value.type != 'l') return false;
+    size_t size = static_cast<size_t>(value.arrayLength) * 8;
+    if (value.encoding == 0) {
+        if (value.data.size != size) return false;
+        if (size > 0) std::memcpy(dst, value.data.data, size);
+        return true;
+    }
+    return value.encoding == 1 && ZlibInflater::Inflate(value.data.data, value.data.size, dst, size);
+}
+
+// Hands an 'i' array to fn(int32_t* chunk, size_t count) in consecutive,
+// writable chunks. Raw arrays are copied through a small stack buffer
+// instead of being decoded whole; zlib arrays are inflated first.
+template <typename Fn>
+inline bool ForEachFbxIntChunk(const FbxPropertyValue& value, Fn fn) {
+    const size_t kChunk = 4096;
+    if (value.type != 'i') return false;
+    if (value.encoding == 0) {
+        if (value.data.size != static_cast<size_t>(value.arrayLength) * 4) return false;
+        int32_t chunk[kChunk];
+        for (size_t done = 0; done < value.arrayLength;) {
+            size_t count = std::min<size_t>(kChunk, value.arrayLength - done);
+            std::memcpy(chunk, value.data.data + done * 4, count * 4);
+            fn(chunk, count);
+            done += count;
+        }
+        return true;
+    }
+    std::vector<int32_t> values(value.arrayLength);
+    if (!ReadFbxArray32(value, values.data())) return false;
+    for (size_t done = 0; done < values.size(); done += kChunk) {
+        fn(values.data() + done, std::min<size_t>(kChunk, values.size() - done));
+    }
+    return true;
+}
+
+// Appends typed properties to a property list.
+struct FbxPropertyBuilder {
+    std::string data;
+    uint64_t count = 0;
+
+    void AddInt(int32_t val) { Add('I', &val, sizeof(val)); }
+    void AddLong(int64_t val) { Add('L', &val, sizeof(val)); }
+    void AddDouble(double val) { Add('D', &val, sizeof(val)); }
+    void AddString(const char* str, size_t len) { AddBytes('S', str, len); }
+    void AddString(const std::string& str) { AddString(str.data(), str.size()); }
+    void AddRaw(const char* bytes, size_t len) { AddBytes('R', bytes, len); }
+
+    // Uncompressed arrays (encoding 0).
+    void AddIntArray(const int32_t* values, size_t length) { AddArray('i', values, length, sizeof(int32_t)); }
+    void AddDoubleArray(const double* values, size_t length) { AddArray('d', values, length, sizeof(double)); }
+
+    // Any array type, e.g. one picked from a table ('b' 'i' 'l' 'f' 'd').
+    void AddArray(char type, const void* values, size_t length, size_t elementSize) {
+        data.push_back(type);
+        uint32_t header[3] = { static_cast<uint32_t>(length), 0, static_cast<uint32_t>(length * elementSize) };
+        data.append(reinterpret_cast<const char*>(header), sizeof(header));
+        data.append(static_cast<const char*>(values), length * elementSize);
+        count++;
+    }
+
+private:
+    void Add(char type, const void* val, size_t size) {
+        data.push_back(type);
+        data.append(static_cast<const char*>(val), size);
+        count++;
+    }
+
+    void AddBytes(char type, const char* bytes, size_t len) {
+        uint32_t len32 = static_cast<uint32_t>(len);
+        data.push_back(type);
+        data.append(reinterpret_cast<const char*>(&len32), sizeof(len32));
+        data.append(bytes, len);
+        count++;
+    }
+};
+
+// ============================================================================
+// Document
+// ============================================================================
+
+class FbxBinaryDocument {
+public:
+    uint32_t version = 0;
+    std::vector<FbxNodeRecord> nodes;
+
+    // Starts an empty document to be filled in and written, e.g. by a generator.
+    void Reset(uint32_t fileVersion) {
+        static const char kFooterId[16] = {
+            '\xfa', '\xbc', '\xab', '\x09', '\xd0', '\xc8', '\xd4', '\x66',
+            '\xb1', '\x76', '\xfb', '\x83', '\x1c', '\xf7', '\x26', '\x7e' };
+        static const char kFooterMagic[16] = {
+            '\xf8', '\x5a', '\x8c', '\x6a', '\xde', '\xf5', '\xd9', '\x7e',
+            '\xec', '\xe9', '\x0c', '\xe3', '\x75', '\x8f', '\x29', '\x0b' };
+        version = fileVersion;
+        wide = version >= 7500;
+        base = nullptr;
+        nodes.clear();
+        footerId.assign(kFooterId, sizeof(kFooterId));
+        footerTail.assign(reinterpret_cast<const char*>(&version), sizeof(version));
+        footerTail.append(120, '\0');
+        footerTail.append(kFooterMagic, sizeof(kFooterMagic));
+    }
+
+    // Parses a mapped binary FBX. The mapping must outlive the document.
+    bool Parse(const MappedFile& file, std::string& error) {
+        base = file.Data();
+        size_t size = file.Size();
+        if (!ReadFbxBinaryHeader(base, size, version, error)) return false;
+        wide = version >= 7500;
+
+        const char* pos = base + kFbxBinaryHeaderSize;
+        const char* end = base + size;
+        if (!ParseList(pos, end, nodes, 0)) {
+            error = "malformed node record";
+            return false;
+        }
+
+        // Footer id, zero padding, then the fixed tail.
+        if (static_cast<size_t>(end - pos) < 16 + kFbxFooterTailSize) {
+            error = "unexpected footer";
+            return false;
+        }
+        footerId.assign(pos, 16);
+        footerTail.assign(end - kFbxFooterTailSize, kFbxFooterTailSize);
+        for (const char* p = pos + 16; p < end - kFbxFooterTailSize; p++) {
+            if (*p != 0) {
+                error = "unexpected footer";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    FbxNodeRecord* FindNode(const char* name) {
+        for (FbxNodeRecord& node : nodes) {
+            if (node.name == name) return &node;
+        }
+        return nullptr;
+    }
+
+    bool Write(const std::string& path, std::string& error) const {
+        uint64_t total = kFbxBinaryHeaderSize + NullRecordSize();
+        for (const FbxNodeRecord& node : nodes) total += NodeSize(node);
+        if (!wide && total > 0xFFFFFFFFull) {
+            error = "patched file exceeds 4 GB offsets of FBX " + std::to_string(version);
+            return false;
+        }
+
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) {
+            error = "could not open " + path;
+            return false;
+        }
+        std::vector<char> buffer(1 << 20);
+        out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+
+        out.write(kFbxBinaryMagic, sizeof(kFbxBinaryMagic));
+        out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+
+        uint64_t offset = kFbxBinaryHeaderSize;
+        for (const FbxNodeRecord& node : nodes) WriteNode(out, node, offset);
+        WriteNullRecord(out, offset);
+
+        out.write(footerId.data(), footerId.size());
+        offset += footerId.size();
+        size_t pad = static_cast<size_t>(((offset + 15) & ~uint64_t(15)) - offset);
+        if (pad == 0) pad = 16;
+        out.write(std::string(pad, '\0').data(), pad);
+        out.write(footerTail.data(), footerTail.size());
+
+        out.close();
+        if (out.fail()) {
+            error = "could not write " + path;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const char* base = nullptr;
+    bool wide = false;
+    std::string footerId;
+    std::string footerTail;
+
+    size_t HeaderSize() const { return wide ? 25 : 13; }
+    size_t NullRecordSize() const { return HeaderSize(); }
+
+    bool ReadWord(const char*& pos, const char* end, uint64_t& val) const {
+        if (wide) {
+            if (end - pos < 8) return false;
+            std::memcpy(&val, pos, 8);
+            pos += 8;
+        }
+        else {
+            uint32_t v;
+            if (end - pos < 4) return false;
+            std::memcpy(&v, pos, 4);
+            pos += 4;
+            val = v;
+        }
+        return true;
+    }
+
+    // Reads records until a null record (or end, at depth 0).
+    bool ParseList(const char*& pos, const char* end, std::vector<FbxNodeRecord>& list, int depth) {
+        while (true) {
+            if (depth > 64) return false;
+            if (static_cast<size_t>(end - pos) < HeaderSize()) return depth == 0 && pos == end;
+
+            const char* start = pos;
+            uint64_t endOffset = 0, propertyCount = 0, propertyLength = 0;
+            ReadWord(pos, end, endOffset);
+            ReadWord(pos, end, propertyCount);
+            ReadWord(pos, end, propertyLength);
+            uint8_t nameLength = static_cast<uint8_t>(*pos++);
+            if (endOffset == 0 && propertyCount == 0 && propertyLength == 0 && nameLength == 0) {
+                return true;
+            }
+
+            const char* nodeEnd = base + endOffset;
+            if (nodeEnd <= start || nodeEnd > end || static_cast<size_t>(nodeEnd - pos) < nameLength) return false;
+
+            list.emplace_back();
+            FbxNodeRecord& node = list.back();
+            node.name.assign(pos, nameLength);
+            pos += nameLength;
+            if (static_cast<uint64_t>(nodeEnd - pos) < propertyLength) return false;
+            node.propertyCount = propertyCount;
+            node.sourceProperties.data = pos;
+            node.sourceProperties.size = static_cast<size_t>(propertyLength);
+            pos += propertyLength;
+
+            if (pos < nodeEnd) {
+                node.hasNullRecord = true;
+                if (!ParseList(pos, nodeEnd, node.children, depth + 1) || pos != nodeEnd) return false;
+            }
+        }
+    }
+
+    uint64_t NodeSize(const FbxNodeRecord& node) const {
+        uint64_t size = HeaderSize() + node.name.size() + node.Properties().size;
+        for (const FbxNodeRecord& child : node.children) size += NodeSize(child);
+        if (node.hasNullRecord || !node.children.empty()) size += NullRecordSize();
+        return size;
+    }
+
+    void WriteWord(std::ofstream& out, uint64_t val) const {
+        if (wide) {
+            out.write(reinterpret_cast<const char*>(&val), 8);
+        }
+        else {
+            uint32_t v = static_cast<uint32_t>(val);
+            out.write(reinterpret_cast<const char*>(&v), 4);
+        }
+    }
+
+    void WriteNullRecord(std::ofstream& out, uint64_t& offset) const {
+        static const char zeros[25] = {};
+        out.write(zeros, NullRecordSize());
+        offset += NullRecordSize();
+    }
+
+    void WriteNode(std::ofstream& out, const FbxNodeRecord& node, uint64_t& offset) const {
+        ByteSpan properties = node.Properties();
+        uint64_t endOffset = offset + NodeSize(node);
+        WriteWord(out, endOffset);
+        WriteWord(out, node.propertyCount);
+        WriteWord(out, properties.size);
+        out.put(static_cast<char>(node.name.size()));
+        out.write(node.name.data(), node.name.size());
+        out.write(properties.data, properties.size);
+        offset += HeaderSize() + node.name.size() + properties.size;
+
+        for (const FbxNodeRecord& child : node.children) WriteNode(out, child, offset);
+        if (node.hasNullRecord || !node.children.empty()) WriteNullRecord(out, offset);
+    }
+};
+
+// ============================================================================
+// Streaming scan
+// ============================================================================
+//
+// Reads records in place from a mapping: Next() returns one header at a time
+// and moves to its endOffset, so a record's properties and children are only
+// touched if the caller asks for them. Nothing is allocated.
+
+struct FbxRecordView {
+    const char* name = nullptr;
+    size_t nameLength = 0;
+    uint64_t propertyCount = 0;
+    ByteSpan properties;
+    const char* childrenBegin = nullptr;
+    const char* end = nullptr;
+
+    bool Is(const char* other) const {
+        return std::strlen(other) == nameLength && std::memcmp(name, other, nameLength) == 0;
+    }
+};
+
+class FbxRecordScanner {
+public:
+    // Positions the scanner on the top-level records of a mapped file.
+    bool Open(const char* data, size_t size, std::string& error) {
+        base = data;
+        if (!ReadFbxBinaryHeader(base, size, version, error)) return false;
+        wide = version >= 7500;
+        pos = base + kFbxBinaryHeaderSize;
+        end = base + size;
+        return true;
+    }
+
+    // Scanner over the children of a record returned by Next().
+    FbxRecordScanner Children(const FbxRecordView& record) const {
+        FbxRecordScanner children = *this;
+        children.pos = record.childrenBegin;
+        children.end = record.end;
+        return children;
+    }
+
+    // False at the null record ending the list, or on malformed data.
+    bool Next(FbxRecordView& record) {
+        size_t headerSize = wide ? 25 : 13;
+        if (failed || static_cast<size_t>(end - pos) < headerSize) return false;
+
+        const char* start = pos;
+        uint64_t endOffset = ReadWord(), propertyCount = ReadWord(), propertyLength = ReadWord();
+        uint8_t nameLength = static_cast<uint8_t>(*pos++);
+        if (endOffset == 0 && propertyCount == 0 && propertyLength == 0 && nameLength == 0) return false;
+
+        if (endOffset > static_cast<uint64_t>(end - base) || base + endOffset <= start ||
+            static_cast<uint64_t>(base + endOffset - pos) < nameLength + propertyLength) {
+            failed = true;
+            return false;
+        }
+        record.name = pos;
+        record.nameLength = nameLength;
+        record.propertyCount = propertyCount;
+        record.properties.data = pos + nameLength;
+        record.properties.size = static_cast<size_t>(propertyLength);
+        record.childrenBegin = record.properties.data + record.properties.size;
+        record.end = base + endOffset;
+        pos = record.end;
+        return true;
+    }
+
+    bool Failed() const { return failed; }
+    uint32_t Version() const { return version; }
+
+private:
+    const char* base = nullptr;
+    const char* pos = nullptr;
+    const char* end = nullptr;
+    uint32_t version = 0;
+    bool wide = false;
+    bool failed = false;
+
+    uint64_t ReadWord() {
+        uint64_t val = 0;
+        if (wide) {
+            std::memcpy(&val, pos, 8);
+            pos += 8;
+        }
+        else {
+            uint32_t v;
+            std::memcpy(&v, pos, 4);
+            pos += 4;
+            val = v;
+        }
+        return val;
+    }
+};
@@ -0,0 +1,584 @@
+﻿#pragma once
+#include "CacheReader.h"
+#include "FbxBinary.h"
+#include "NameFilter.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Patch-in-place injection (binary FBX)
+// ============================================================================
+//
+// Rewrites only the Document and Geometry records of a binary FBX, adding
+// the same properties and user-data layer the SDK path creates, and copies
+// every other record through unchanged. Anything unexpected (ASCII file,
+// instanced geometry, a document that already has RizomUV data) returns
+// false so the caller can fall back to the SDK path.
+
+struct InjectOptions {
+    bool patchInPlace = false;
+    bool checkTopology = true;
+    unsigned threadCount = 1;  // meshes remapped concurrently
+    NameFilter filter;         // meshes left out keep their data and are not read from the cache
+};
+
+// --patch, --ignore-topology, --threads; i is advanced past a value. Shared
+// by the Injector and the bridge library.
+inline bool ParseInjectFlag(int argc, const char* const* argv, int& i, InjectOptions& options) {
+    std::string arg = argv[i];
+    if (arg == "--patch") {
+        options.patchInPlace = true;
+    }
+    else if (arg == "--ignore-topology") {
+        options.checkTopology = false;
+    }
+    else if (arg == "--threads" && i + 1 < argc) {
+        options.threadCount = ThreadCountArg(argv[++i]);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+inline FbxNodeRecord MakeFbxNode(const char* name, FbxPropertyBuilder& props) {
+    FbxNodeRecord node;
+    node.name = name;
+    node.SetProperties(std::move(props.data), props.count);
+    return node;
+}
+
+// P: "name", "type", "label", "U", values, with blobs in a BinaryData
+// child. Type, label and value encoding come from kPropertyTypes; without a
+// cached value the property is written as defaultType, zeroed.
+inline void AppendUserProperty(FbxNodeRecord& properties70, const std::string& name,
+    const CacheProperty* cached, PropertyType defaultType) {
+
+    PropertyType type = cached ? cached->type : defaultType;
+    const PropertyTypeInfo& info = GetPropertyTypeInfo(type);
+    size_t size = cached ? cached->value.size : 0;
+    const char* data = cached ? cached->value.data : "";
+    bool hasElements = size != 0 && size == PropertyValueSize(type);
+
+    FbxNodeRecord p;
+    FbxPropertyBuilder props;
+    props.AddString(name);
+    props.AddString(info.fbxType);
+    props.AddString(info.fbxLabel);
+    props.AddString("U", 1);
+
+    if (info.kind == kValueBlob) {
+        props.AddInt(static_cast<int32_t>(size));
+        p = MakeFbxNode("P", props);
+        FbxPropertyBuilder blob;
+        blob.AddRaw(data, size);
+        p.AddChild("BinaryData").SetProperties(std::move(blob.data), blob.count);
+    }
+    else if (info.kind == kValueString) {
+        props.AddString(data, size);
+        p = MakeFbxNode("P", props);
+    }
+    else {
+        for (uint8_t i = 0; i < info.elementCount; i++) {
+            if (info.kind == kValueReal) props.AddDouble(hasElements ? ReadRealElement(type, data, i) : 0.0);
+            else if (info.elementSize == sizeof(int64_t)) props.AddLong(hasElements ? ReadIntegerElement(type, data, i) : 0);
+            else props.AddInt(static_cast<int32_t>(hasElements ? ReadIntegerElement(type, data, i) : 0));
+        }
+        p = MakeFbxNode("P", props);
+    }
+    properties70.hasNullRecord = true;
+    properties70.children.push_back(std::move(p));
+}
+
+inline bool HasUserProperty(const FbxNodeRecord& properties70, const char* name) {
+    for (const FbxNodeRecord& p : properties70.children) {
+        FbxPropertyValue value;
+        if (p.name == "P" && GetFbxProperty(p, 0, value) && FbxPropertyString(value) == name) return true;
+    }
+    return false;
+}
+
+inline FbxNodeRecord& GetOrAddChild(FbxNodeRecord& node, const char* name) {
+    FbxNodeRecord* child = node.FindChild(name);
+    return child ? *child : node.AddChild(name);
+}
+
+inline bool PatchDocument(FbxBinaryDocument& fbx, const PropertyMap& properties, std::string& reason) {
+    FbxNodeRecord* documents = fbx.FindNode("Documents");
+    FbxNodeRecord* document = documents ? documents->FindChild("Document") : nullptr;
+    FbxPropertyValue id, name;
+    if (!document || !GetFbxProperty(*document, 0, id) || id.type != 'L') {
+        reason = "no Document record";
+        return false;
+    }
+
+    FbxNodeRecord& properties70 = GetOrAddChild(*document, "Properties70");
+    if (HasUserProperty(properties70, "RizomUV")) {
+        reason = "document already has RizomUV data";
+        return false;
+    }
+
+    // Same as rootDocument->SetName("Scene") on the SDK path.
+    if (!GetFbxProperty(*document, 1, name) || FbxPropertyString(name) != "Scene") {
+        FbxPropertyBuilder props;
+        props.AddLong(id.integer);
+        props.AddString("Scene");
+        props.AddString("Scene");
+        document->SetProperties(std::move(props.data), props.count);
+    }
+
+    AppendUserProperty(properties70, "RizomUV", FindProperty(properties, "RizomUV"), kPropertyInt);
+    AppendUserProperty(properties70, "RizomUV|Scene", FindProperty(properties, "Scene"), kPropertyBlob);
+    AppendUserProperty(properties70, "RizomUV|UVSets", FindProperty(properties, "UVSets"), kPropertyString);
+    AppendUserProperty(properties70, "RizomUV|UVSets|UVMap", FindProperty(properties, "UVMap"), kPropertyString);
+    AppendUserProperty(properties70, "RizomUV|UVSets|UVMap|RootGroup", FindProperty(properties, "RootGroup"),
+        kPropertyBlob);
+    BRIDGE_LOG_ITEM("  Patched: Document RizomUV property hierarchy");
+    return true;
+}
+
+inline FbxNodeRecord& AddFbxChild(FbxNodeRecord& node, const char* name, FbxPropertyBuilder& props) {
+    FbxNodeRecord& child = node.AddChild(name);
+    child.SetProperties(std::move(props.data), props.count);
+    return child;
+}
+
+inline FbxNodeRecord& AddStringChild(FbxNodeRecord& node, const char* name, const std::string& value) {
+    FbxPropertyBuilder props;
+    props.AddString(value);
+    return AddFbxChild(node, name, props);
+}
+
+inline FbxNodeRecord& AddIntChild(FbxNodeRecord& node, const char* name, int32_t value) {
+    FbxPropertyBuilder props;
+    props.AddInt(value);
+    return AddFbxChild(node, name, props);
+}
+
+// Removes the P records named name, so an appended one replaces them, as
+// FbxProperty::Create and Set do on the SDK path.
+inline bool RemoveUserProperty(FbxNodeRecord& properties70, const char* name) {
+    std::vector<FbxNodeRecord>& children = properties70.children;
+    size_t before = children.size();
+    children.erase(std::remove_if(children.begin(), children.end(), [name](const FbxNodeRecord& p) {
+        FbxPropertyValue value;
+        return p.name == "P" && GetFbxProperty(p, 0, value) && FbxPropertyString(value) == name;
+    }), children.end());
+    return children.size() != before;
+}
+
+// TypedIndex of the LayerElementUserData a Layer record references, or -1.
+inline int64_t LayerUserDataIndex(const FbxNodeRecord& layer, size_t* position = nullptr) {
+    for (size_t i = 0; i < layer.children.size(); i++) {
+        const FbxNodeRecord& element = layer.children[i];
+        if (element.name != "LayerElement") continue;
+        FbxPropertyValue value;
+        bool isUserData = false;
+        int64_t typedIndex = -1;
+        for (const FbxNodeRecord& field : element.children) {
+            if (field.name == "Type" && GetFbxProperty(field, 0, value)) {
+                isUserData = FbxPropertyString(value) == "LayerElementUserData";
+            }
+            else if (field.name == "TypedIndex" && GetFbxProperty(field, 0, value)) {
+                typedIndex = value.integer;
+            }
+        }
+        if (isUserData) {
+            if (position) *position = i;
+            return typedIndex;
+        }
+    }
+    return -1;
+}
+
+// Detaches the user data element of layer layerIndex, as FbxLayer::SetUserData
+// does when the SDK path injects on that layer. The element itself is dropped
+// unless another layer still references it. Returns whether one was attached.
+inline bool DetachLayerUserData(FbxNodeRecord& geometry, uint32_t layerIndex) {
+    int64_t detached = -1;
+    for (FbxNodeRecord& child : geometry.children) {
+        FbxPropertyValue index;
+        if (child.name != "Layer" || !GetFbxProperty(child, 0, index) || index.integer != layerIndex) continue;
+        size_t position = 0;
+        detached = LayerUserDataIndex(child, &position);
+        if (detached >= 0) child.children.erase(child.children.begin() + static_cast<std::ptrdiff_t>(position));
+        break;
+    }
+    if (detached < 0) return false;
+
+    bool stillReferenced = false;
+    for (const FbxNodeRecord& child : geometry.children) {
+        if (child.name == "Layer" && LayerUserDataIndex(child) == detached) stillReferenced = true;
+    }
+    if (!stillReferenced) {
+        std::vector<FbxNodeRecord>& children = geometry.children;
+        children.erase(std::remove_if(children.begin(), children.end(), [detached](const FbxNodeRecord& element) {
+            FbxPropertyValue index;
+            return element.name == "LayerElementUserData" && GetFbxProperty(element, 0, index) &&
+                index.integer == detached;
+        }), children.end());
+    }
+    return true;
+}
+
+// First TypedIndex no LayerElementUserData of the geometry uses.
+inline int32_t NextUserDataIndex(const FbxNodeRecord& geometry) {
+    int32_t next = 0;
+    for (const FbxNodeRecord& child : geometry.children) {
+        FbxPropertyValue index;
+        if (child.name == "LayerElementUserData" && GetFbxProperty(child, 0, index) && index.integer >= next) {
+            next = static_cast<int32_t>(index.integer + 1);
+        }
+    }
+    return next;
+}
+
+// Layer layerIndex of a geometry, creating it and any layer below it that
+// is missing, as FbxMesh::CreateLayer would.
+inline FbxNodeRecord& GetOrAddLayer(FbxNodeRecord& geometry, uint32_t layerIndex) {
+    for (uint32_t i = 0;; i++) {
+        FbxNodeRecord* layer = nullptr;
+        for (FbxNodeRecord& child : geometry.children) {
+            FbxPropertyValue index;
+            if (child.name == "Layer" && GetFbxProperty(child, 0, index) && index.integer == i) {
+                layer = &child;
+                break;
+            }
+        }
+        if (!layer) {
+            FbxPropertyBuilder props;
+            props.AddInt(static_cast<int32_t>(i));
+            geometry.children.push_back(MakeFbxNode("Layer", props));
+            layer = &geometry.children.back();
+            AddIntChild(*layer, "Version", 100);
+        }
+        if (i == layerIndex) return *layer;
+    }
+}
+
+// LayerElementUserData typedIndex for geoData.userData[first, last), with
+// one UserDataArray per array, referenced from the element's layer.
+// remapped, when given, replaces the cached values.
+inline bool PatchUserDataElement(FbxNodeRecord& geometry, const GeometryData& geoData, size_t first, size_t last,
+    int32_t typedIndex, const RemappedUserData* remapped, std::string& reason) {
+    const UserDataArray& element = geoData.userData[first];
+    std::string userDataName = element.elementName.size == 0 ? "RizomUVUVMapIslandGroupIDs" :
+        std::string(element.elementName.data, element.elementName.size);
+
+    FbxPropertyBuilder idProps;
+    idProps.AddInt(typedIndex);
+    FbxNodeRecord userData = MakeFbxNode("LayerElementUserData", idProps);
+    AddIntChild(userData, "Version", 101);
+    AddStringChild(userData, "Name", userDataName);
+    AddStringChild(userData, "MappingInformationType", UserDataMappingName(element.mapping));
+    AddStringChild(userData, "ReferenceInformationType", UserDataReferenceName(element.reference));
+
+    std::vector<char> decoded;
+    for (size_t a = first; a < last; a++) {
+        const UserDataArray& array = geoData.userData[a];
+        size_t valueSize = PropertyValueSize(array.type);
+        const char* values = array.values.data;
+        size_t count = array.values.count;
+        if (remapped) {
+            values = (*remapped)[a].data();
+            count = (*remapped)[a].size() / valueSize;
+        }
+        else if (array.values.rle) {
+            decoded.resize(count * valueSize);
+            if (!CopyUserDataValues(array, decoded.data())) {
+                reason = "user data of '" + userDataName + "' could not be decoded";
+                return false;
+            }
+            values = decoded.data();
+        }
+
+        FbxNodeRecord& arrayNode = userData.AddChild("UserDataArray");
+        AddStringChild(arrayNode, "UserDataType", GetPropertyTypeInfo(array.type).name);
+        AddStringChild(arrayNode, "UserDataName", std::string(array.arrayName.data, array.arrayName.size));
+        FbxPropertyBuilder valueProps;
+        valueProps.AddArray(UserDataArrayCode(array.type), values, count, valueSize);
+        AddFbxChild(arrayNode, "UserData", valueProps);
+        BRIDGE_LOG_ITEM("  Patched: " << count << " " << GetPropertyTypeInfo(array.type).name << " values ('"
+            << std::string(array.arrayName.data, array.arrayName.size) << "' of '" << userDataName << "', layer "
+            << element.layer << ")");
+    }
+    geometry.children.push_back(std::move(userData));
+    geometry.hasNullRecord = true;
+
+    FbxNodeRecord& layer = GetOrAddLayer(geometry, element.layer);
+    FbxNodeRecord& layerElement = layer.AddChild("LayerElement");
+    AddStringChild(layerElement, "Type", "LayerElementUserData");
+    AddIntChild(layerElement, "TypedIndex", typedIndex);
+    return true;
+}
+
+// remapped, when given, replaces the cached user data (RemapUserData).
+// Data already on the geometry is replaced the way the SDK path replaces
+// it: cached properties overwrite theirs, and each cached element takes
+// the place of its layer's user data. replaced reports whether any was.
+inline bool PatchGeometry(FbxNodeRecord& geometry, const GeometryData& geoData,
+    const RemappedUserData* remapped, bool& replaced, std::string& reason) {
+    replaced = false;
+    {
+        FbxNodeRecord& properties70 = GetOrAddChild(geometry, "Properties70");
+        for (const char* propName : { "RizomUV", "RizomUVUVSets" }) {
+            if (const CacheProperty* cached = FindProperty(geoData.properties, propName)) {
+                if (RemoveUserProperty(properties70, propName)) replaced = true;
+                AppendUserProperty(properties70, propName, cached, kPropertyNone);
+                BRIDGE_LOG_ITEM("  Patched: " << propName);
+            }
+        }
+    }
+
+    for (size_t first = 0; first < geoData.userData.size();) {
+        size_t last = UserDataElementEnd(geoData.userData, first);
+        bool empty = remapped ? (*remapped)[first].empty() : geoData.userData[first].values.count == 0;
+        if (!empty) {
+            if (DetachLayerUserData(geometry, geoData.userData[first].layer)) replaced = true;
+            if (!PatchUserDataElement(geometry, geoData, first, last, NextUserDataIndex(geometry), remapped, reason)) {
+                return false;
+            }
+        }
+        first = last;
+    }
+    return true;
+}
+
+// Mesh geometries of a parsed target, the model each one belongs to, and
+// the node/mesh names of the geometries filter selects, i.e. those whose
+// cache data is needed.
+struct PatchPlan {
+    std::map<int64_t, FbxNodeRecord*> geometries;
+    std::map<int64_t, std::string> geometryModel;
+    std::set<std::string> sceneMeshNames;
+};
+
+inline bool PlanPatch(FbxBinaryDocument& fbx, const NameFilter& filter, PatchPlan& plan, std::string& reason) {
+    FbxNodeRecord* objects = fbx.FindNode("Objects");
+    FbxNodeRecord* connections = fbx.FindNode("Connections");
+    if (!objects || !connections) {
+        reason = "no Objects/Connections records";
+        return false;
+    }
+
+    std::map<int64_t, std::string> modelNames, geometryNames;
+    for (FbxNodeRecord& object : objects->children) {
+        FbxPropertyValue id, name, type;
+        if (!GetFbxProperty(object, 0, id) || !GetFbxProperty(object, 1, name) || !GetFbxProperty(object, 2, type)) continue;
+        if (object.name == "Geometry" && FbxPropertyString(type) == "Mesh") {
+            plan.geometries[id.integer] = &object;
+            geometryNames[id.integer] = FbxObjectName(name);
+        }
+        else if (object.name == "Model") {
+            modelNames[id.integer] = FbxObjectName(name);
+        }
+    }
+
+    for (const FbxNodeRecord& c : connections->children) {
+        FbxPropertyValue kind, child, parent;
+        if (c.name != "C" || !GetFbxProperty(c, 0, kind) || FbxPropertyString(kind) != "OO" ||
+            !GetFbxProperty(c, 1, child) || !GetFbxProperty(c, 2, parent)) continue;
+        if (!plan.geometries.count(child.integer) || !modelNames.count(parent.integer)) continue;
+        if (plan.geometryModel.count(child.integer)) {
+            reason = "instanced geometry";
+            return false;
+        }
+        plan.geometryModel[child.integer] = modelNames[parent.integer];
+    }
+
+    for (const auto& geometry : geometryNames) {
+        auto model = plan.geometryModel.find(geometry.first);
+        std::string nodeName = model != plan.geometryModel.end() ? model->second : std::string();
+        if (!filter.Selects(nodeName, geometry.second)) continue;
+        plan.sceneMeshNames.insert(geometry.second);
+        if (!nodeName.empty()) plan.sceneMeshNames.insert(nodeName);
+    }
+    return true;
+}
+
+// Fingerprint of a Geometry record's PolygonVertexIndex, computed the way
+// the extraction backends do it (Topology.h).
+inline bool FingerprintGeometry(const FbxNodeRecord& geometry, TopologyFingerprint& fingerprint) {
+    FbxTopologyBuilder builder;
+    for (const FbxNodeRecord& child : geometry.children) {
+        if (child.name != "PolygonVertexIndex") continue;
+        FbxPropertyValue value;
+        if (!GetFbxProperty(child, 0, value) ||
+            !ForEachFbxIntChunk(value, [&](int32_t* chunk, size_t count) { builder.Add(chunk, count); })) return false;
+        break;
+    }
+    return builder.Finish(fingerprint);
+}
+
+// Polygon samples of a Geometry record's Vertices and PolygonVertexIndex
+// (Remap.h), matching those the extractor stores.
+inline bool SampleGeometry(const FbxNodeRecord& geometry, std::vector<PolygonSample>& samples) {
+    FbxPropertyValue vertices, indices;
+    bool hasVertices = false, hasIndices = false;
+    for (const FbxNodeRecord& child : geometry.children) {
+        if (child.name == "Vertices") hasVertices = GetFbxProperty(child, 0, vertices);
+        else if (child.name == "PolygonVertexIndex") hasIndices = GetFbxProperty(child, 0, indices);
+    }
+    if (!hasVertices || !hasIndices || indices.type != 'i') return false;
+
+    std::vector<double> points(vertices.arrayLength);
+    std::vector<int32_t> polygonVertices(indices.arrayLength);
+    if (!ReadFbxArray64(vertices, points.data()) || !ReadFbxArray32(indices, polygonVertices.data())) return false;
+    PolygonSampler sampler(points.data(), 3, points.size() / 3);
+    return SampleFbxPolygons(sampler, polygonVertices.data(), polygonVertices.size(), samples);
+}
+
+// Geometries without cache data or outside options.filter are left alone.
+// With checkTopology, those whose polygons changed since extraction get
+// their island IDs remapped when the cache has polygon samples, and are
+// skipped otherwise (reported on stderr). Remapping runs across
+// options.threadCount threads.
+inline bool ApplyPatch(FbxBinaryDocument& fbx, const PatchPlan& plan, const PropertyMap& documentProperties,
+    GeometryTable& geometryData, const InjectOptions& options, std::string& reason) {
+    ScopedPhase phase("patch");
+    if (!PatchDocument(fbx, documentProperties, reason)) return false;
+
+    struct PatchTarget {
+        FbxNodeRecord* geometry;
+        const GeometryData* geoData;
+        std::string lookupName;
+        bool remap;
+        RemappedUserData remapped;
+    };
+    std::vector<PatchTarget> targets;
+    size_t missing = 0, mismatched = 0, filtered = 0;
+    for (const auto& entry : plan.geometries) {
+        FbxPropertyValue name;
+        GetFbxProperty(*entry.second, 1, name);
+        std::string meshName = FbxObjectName(name);
+        auto model = plan.geometryModel.find(entry.first);
+        std::string nodeName = model != plan.geometryModel.end() ? model->second : std::string();
+        if (!options.filter.Selects(nodeName, meshName)) {
+            ++filtered;
+            continue;
+        }
+
+        GeometryData* geoData = geometryData.Find(nodeName);
+        if (!geoData) geoData = geometryData.Find(meshName);
+        if (!geoData || geoData->Empty()) {
+            BRIDGE_LOG_ITEM("  -- No data found for '" << nodeName << "' or '" << meshName << "'");
+            ++missing;
+            continue;
+        }
+
+        const std::string& lookupName = nodeName.empty() ? meshName : nodeName;
+        bool remap = false;
+        if (options.checkTopology && geoData->hasTopology) {
+            TopologyFingerprint current;
+            if (!FingerprintGeometry(*entry.second, current)) {
+                reason = "unreadable PolygonVertexIndex in '" + lookupName + "'";
+                return false;
+            }
+            if (current != geoData->topology) {
+                std::string change = DescribeTopologyChange(geoData->topology, current);
+                if (!CanRemapUserData(*geoData)) {
+                    std::cerr << "Warning: '" << lookupName << "' changed since extraction ("
+                        << change << "), RizomUV data skipped\n";
+                    ++mismatched;
+                    continue;
+                }
+                BRIDGE_LOG_ITEM("  '" << lookupName << "' changed since extraction (" << change << "), remapping");
+                remap = true;
+            }
+        }
+        targets.push_back(PatchTarget{ entry.second, geoData, lookupName, remap, RemappedUserData() });
+    }
+
+    std::vector<char> remapFailed(targets.size(), 0);
+    {
+        ScopedPhase remapPhase("remap");
+        ParallelFor(targets.size(), options.threadCount, [&](size_t i) {
+            PatchTarget& target = targets[i];
+            if (!target.remap) return;
+            std::vector<PolygonSample> samples;
+            remapFailed[i] = !SampleGeometry(*target.geometry, samples) ||
+                !RemapUserData(*target.geoData, samples, target.remapped);
+        });
+    }
+
+    size_t patched = 0, remapped = 0, replaced = 0;
+    for (size_t i = 0; i < targets.size(); i++) {
+        PatchTarget& target = targets[i];
+        if (remapFailed[i]) {
+            std::cerr << "Warning: '" << target.lookupName
+                << "' could not be remapped onto its edited polygons, RizomUV data skipped\n";
+            ++mismatched;
+            continue;
+        }
+        BRIDGE_LOG_ITEM("Patching geometry: " << target.lookupName);
+        bool replacedData = false;
+        if (!PatchGeometry(*target.geometry, *target.geoData, target.remap ? &target.remapped : nullptr,
+            replacedData, reason)) return false;
+        ++patched;
+        if (target.remap) ++remapped;
+        if (replacedData) ++replaced;
+    }
+    phase.Count("meshes", patched);
+    phase.Count("remapped", remapped);
+    phase.Count("mismatched", mismatched);
+    phase.Count("filtered", filtered);
+    BRIDGE_LOG("Patched " << patched << " geometries (" << remapped << " remapped, " << replaced
+        << " replaced older data, " << missing
+        << " without cache data, " << mismatched << " topology mismatches, " << filtered << " filtered out)");
+    return true;
+}
+
+// cacheFailed is set if the cache could not be loaded, e.g. a record failed
+// its checksum: the SDK path would fail the same way.
+// The cache is loaded by pending, started by the caller, while the target is
+// parsed; if the patch is refused before the cache is needed, the caller can
+// still wait on pending for its SDK fallback.
+inline bool PatchBinaryFbx(const char* targetFBX, PendingCache& pending, const char* outputFBX,
+    const InjectOptions& options, std::string& reason, bool& cacheFailed) {
+    cacheFailed = false;
+    BRIDGE_LOG("\n=== Patch-in-place injection ===");
+
+    MappedFile target;
+    if (!target.Open(targetFBX)) {
+        reason = "could not open target";
+        return false;
+    }
+    FbxBinaryDocument fbx;
+    PatchPlan plan;
+    auto parseStart = std::chrono::steady_clock::now();
+    {
+        ScopedPhase phase("parse_target");
+        phase.Count("bytes", target.Size());
+        if (!fbx.Parse(target, reason) || !PlanPatch(fbx, options.filter, plan, reason)) return false;
+    }
+    double parseMs = ElapsedMs(parseStart);
+
+    LoadedCache* cache = pending.Wait(&plan.sceneMeshNames);
+    if (!cache) {
+        reason = "could not load cache: " + pending.Error();
+        cacheFailed = true;
+        return false;
+    }
+    auto patchStart = std::chrono::steady_clock::now();
+    if (!ApplyPatch(fbx, plan, cache->documentProperties, cache->geometryData, options, reason)) return false;
+    double patchMs = ElapsedMs(patchStart);
+
+    BRIDGE_LOG("Saving to: " << outputFBX);
+    auto writeStart = std::chrono::steady_clock::now();
+    bool written;
+    {
+        ScopedPhase phase("write_output");
+        written = fbx.Write(outputFBX, reason);
+    }
+    BRIDGE_LOG("Stages: parse " << parseMs << " ms, cache load " << pending.LoadMs()
+        << " ms (overlapped, waited " << pending.WaitMs() << " ms, finished in " << pending.FinishMs()
+        << " ms), patch " << patchMs << " ms, write " << ElapsedMs(writeStart) << " ms");
+    return written;
+}
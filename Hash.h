@@ -0,0 +1,137 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// ============================================================================
+// XXH64
+// ============================================================================
+//
+// Streaming implementation of the XXH64 hash (same output as the reference
+// xxHash library). The main loop runs four independent 64-bit lanes over
+// 32-byte stripes, so it stays close to memory bandwidth on large arrays.
+
+const uint64_t kXxhPrime1 = 11400714785074694791ull;
+const uint64_t kXxhPrime2 = 14029467366897019727ull;
+const uint64_t kXxhPrime3 = 1609587929392839161ull;
+const uint64_t kXxhPrime4 = 9650029242287828579ull;
+const uint64_t kXxhPrime5 = 2870177450012600261ull;
+
+inline uint64_t XxhRotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t XxhRead64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t XxhRead32(const unsigned char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t XxhRound(uint64_t acc, uint64_t input) {
+    acc += input * kXxhPrime2;
+    acc = XxhRotl(acc, 31);
+    return acc * kXxhPrime1;
+}
+
+inline uint64_t XxhMergeRound(uint64_t acc, uint64_t val) {
+    acc ^= XxhRound(0, val);
+    return acc * kXxhPrime1 + kXxhPrime4;
+}
+
+class Xxh64 {
+public:
+    explicit Xxh64(uint64_t seed = 0) : seed(seed) {
+        lanes[0] = seed + kXxhPrime1 + kXxhPrime2;
+        lanes[1] = seed + kXxhPrime2;
+        lanes[2] = seed;
+        lanes[3] = seed - kXxhPrime1;
+    }
+
+    void Update(const void* data, size_t len) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        const unsigned char* end = p + len;
+        total += len;
+
+        if (pending + len < sizeof(buffer)) {
+            if (len) std::memcpy(buffer + pending, p, len);
+            pending += len;
+            return;
+        }
+        if (pending) {
+            size_t fill = sizeof(buffer) - pending;
+            std::memcpy(buffer + pending, p, fill);
+            Stripe(buffer);
+            p += fill;
+            pending = 0;
+        }
+        while (end - p >= 32) {
+            Stripe(p);
+            p += 32;
+        }
+        pending = static_cast<size_t>(end - p);
+        if (pending) std::memcpy(buffer, p, pending);
+    }
+
+    uint64_t Digest() const {
+        uint64_t h;
+        if (total >= 32) {
+            h = XxhRotl(lanes[0], 1) + XxhRotl(lanes[1], 7) + XxhRotl(lanes[2], 12) + XxhRotl(lanes[3], 18);
+            for (uint64_t lane : lanes) h = XxhMergeRound(h, lane);
+        }
+        else {
+            h = seed + kXxhPrime5;
+        }
+        h += total;
+
+        const unsigned char* p = buffer;
+        const unsigned char* end = buffer + pending;
+        while (end - p >= 8) {
+            h ^= XxhRound(0, XxhRead64(p));
+            h = XxhRotl(h, 27) * kXxhPrime1 + kXxhPrime4;
+            p += 8;
+        }
+        if (end - p >= 4) {
+            h ^= static_cast<uint64_t>(XxhRead32(p)) * kXxhPrime1;
+            h = XxhRotl(h, 23) * kXxhPrime2 + kXxhPrime3;
+            p += 4;
+        }
+        while (p < end) {
+            h ^= *p * kXxhPrime5;
+            h = XxhRotl(h, 11) * kXxhPrime1;
+            p++;
+        }
+
+        h ^= h >> 33;
+        h *= kXxhPrime2;
+        h ^= h >> 29;
+        h *= kXxhPrime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+private:
+    void Stripe(const unsigned char* p) {
+        lanes[0] = XxhRound(lanes[0], XxhRead64(p));
+        lanes[1] = XxhRound(lanes[1], XxhRead64(p + 8));
+        lanes[2] = XxhRound(lanes[2], XxhRead64(p + 16));
+        lanes[3] = XxhRound(lanes[3], XxhRead64(p + 24));
+    }
+
+    uint64_t seed;
+    uint64_t lanes[4];
+    unsigned char buffer[32];
+    size_t pending = 0;
+    uint64_t total = 0;
+};
+
+inline uint64_t Xxh64Hash(const void* data, size_t len, uint64_t seed = 0) {
+    Xxh64 hash(seed);
+    hash.Update(data, len);
+    return hash.Digest();
+}
@@ -0,0 +1,86 @@
+﻿#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// ============================================================================
+// Island ID run-length codec
+// ============================================================================
+//
+// Island group IDs are long runs of the same small value, so 'I' records
+// flagged kRecordFlagRleIds (CacheFormat.h) store them as runs instead of
+// raw ints:
+//
+//   uint32 count | uint32 encodedBytes | runs
+//   run: varint zigzag(value - previous value) | varint length
+//
+// Decoding is a varint read per run followed by a std::fill_n, which the
+// compiler turns into wide stores, so cost is dominated by output bandwidth.
+
+inline void AppendVarint(std::string& out, uint32_t val) {
+    while (val >= 0x80) {
+        out.push_back(static_cast<char>((val & 0x7F) | 0x80));
+        val >>= 7;
+    }
+    out.push_back(static_cast<char>(val));
+}
+
+inline bool ReadVarint(const uint8_t*& pos, const uint8_t* end, uint32_t& val) {
+    val = 0;
+    for (int shift = 0; shift < 35 && pos < end; shift += 7) {
+        uint8_t byte = *pos++;
+        val |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+inline uint32_t ZigZag(int32_t val) {
+    return (static_cast<uint32_t>(val) << 1) ^ static_cast<uint32_t>(val >> 31);
+}
+
+inline int32_t UnZigZag(uint32_t val) {
+    return static_cast<int32_t>(val >> 1) ^ -static_cast<int32_t>(val & 1);
+}
+
+// Appends the encoded array (count, size and runs) to out.
+inline void EncodeRleIds(std::string& out, const int* data, size_t count) {
+    size_t headerPos = out.size();
+    uint32_t header[2] = { static_cast<uint32_t>(count), 0 };
+    out.append(reinterpret_cast<const char*>(header), sizeof(header));
+
+    int previous = 0;
+    size_t i = 0;
+    while (i < count) {
+        int value = data[i];
+        size_t run = 1;
+        while (i + run < count && data[i + run] == value && run < 0xFFFFFFFFu) run++;
+        AppendVarint(out, ZigZag(static_cast<int32_t>(static_cast<uint32_t>(value) - static_cast<uint32_t>(previous))));
+        AppendVarint(out, static_cast<uint32_t>(run));
+        previous = value;
+        i += run;
+    }
+
+    header[1] = static_cast<uint32_t>(out.size() - headerPos - sizeof(header));
+    std::memcpy(&out[headerPos + sizeof(uint32_t)], &header[1], sizeof(uint32_t));
+}
+
+// Decodes runs into dst (count ints). With dst == nullptr only validates
+// that the runs cover exactly count values.
+inline bool DecodeRleIds(const char* src, size_t srcSize, int* dst, size_t count) {
+    const uint8_t* pos = reinterpret_cast<const uint8_t*>(src);
+    const uint8_t* end = pos + srcSize;
+    int previous = 0;
+    size_t written = 0;
+    while (pos < end) {
+        uint32_t delta, run;
+        if (!ReadVarint(pos, end, delta) || !ReadVarint(pos, end, run)) return false;
+        if (run > count - written) return false;
+        int value = static_cast<int>(static_cast<uint32_t>(previous) + static_cast<uint32_t>(UnZigZag(delta)));
+        if (dst) std::fill_n(dst + written, run, value);
+        written += run;
+        previous = value;
+    }
+    return written == count;
+}
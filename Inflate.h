@@ -0,0 +1,240 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// ============================================================================
+// zlib inflate
+// ============================================================================
+//
+// Binary FBX stores large arrays as zlib streams (array encoding 1). This is
+// a small RFC 1950/1951 decoder for the native reader, so it does not need
+// zlib at build time. The output size is always known up front (array length
+// times element size), so it decodes straight into a caller buffer and fails
+// on anything that would overrun it.
+//
+// Symbols are decoded canonically one bit at a time; only the island arrays
+// are ever inflated, so simplicity wins over a table-driven decoder here.
+
+class ZlibInflater {
+public:
+    // Inflates a complete zlib stream into dst; true only if exactly dstSize
+    // bytes were produced and the Adler-32 checksum matches.
+    static bool Inflate(const void* src, size_t srcSize, void* dst, size_t dstSize) {
+        ZlibInflater inflater(static_cast<const uint8_t*>(src), srcSize, static_cast<uint8_t*>(dst), dstSize);
+        return inflater.Run();
+    }
+
+private:
+    struct Huffman {
+        uint16_t count[16];
+        uint16_t symbol[288];
+    };
+
+    const uint8_t* in;
+    const uint8_t* inEnd;
+    uint8_t* out;
+    uint8_t* outPos;
+    uint8_t* outEnd;
+    uint32_t bitBuffer = 0;
+    int bitCount = 0;
+    bool overrun = false;
+
+    ZlibInflater(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+        : in(src), inEnd(src + srcSize), out(dst), outPos(dst), outEnd(dst + dstSize) {}
+
+    uint32_t Bits(int count) {
+        uint32_t val = bitBuffer;
+        while (bitCount < count) {
+            if (in == inEnd) {
+                overrun = true;
+                return 0;
+            }
+            val |= static_cast<uint32_t>(*in++) << bitCount;
+            bitCount += 8;
+        }
+        bitBuffer = val >> count;
+        bitCount -= count;
+        return val & ((1u << count) - 1);
+    }
+
+    // Builds canonical code counts/symbols; false if the lengths over-subscribe.
+    static bool Build(Huffman& h, const uint8_t* lengths, int count) {
+        for (int len = 0; len < 16; len++) h.count[len] = 0;
+        for (int i = 0; i < count; i++) h.count[lengths[i]]++;
+        if (h.count[0] == count) return true;
+
+        int left = 1;
+        for (int len = 1; len < 16; len++) {
+            left <<= 1;
+            left -= h.count[len];
+            if (left < 0) return false;
+        }
+
+        uint16_t offsets[16];
+        offsets[1] = 0;
+        for (int len = 1; len < 15; len++) offsets[len + 1] = offsets[len] + h.count[len];
+        for (int i = 0; i < count; i++) {
+            if (lengths[i] != 0) h.symbol[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+        }
+        return true;
+    }
+
+    int Decode(const Huffman& h) {
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len < 16; len++) {
+            code |= static_cast<int>(Bits(1));
+            if (overrun) return -1;
+            int count = h.count[len];
+            if (code - count < first) return h.symbol[index + (code - first)];
+            index += count;
+            first += count;
+            first <<= 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    bool Stored() {
+        bitBuffer = 0;
+        bitCount = 0;
+        if (inEnd - in < 4) return false;
+        uint32_t len = in[0] | (in[1] << 8);
+        uint32_t nlen = in[2] | (in[3] << 8);
+        in += 4;
+        if (len != (~nlen & 0xFFFF)) return false;
+        if (static_cast<size_t>(inEnd - in) < len || static_cast<size_t>(outEnd - outPos) < len) return false;
+        for (uint32_t i = 0; i < len; i++) *outPos++ = *in++;
+        return true;
+    }
+
+    bool Codes(const Huffman& lengthCodes, const Huffman& distCodes) {
+        static const uint16_t lengthBase[29] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const uint8_t lengthExtra[29] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const uint16_t distBase[30] = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static const uint8_t distExtra[30] = {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+            7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        while (true) {
+            int symbol = Decode(lengthCodes);
+            if (symbol < 0) return false;
+            if (symbol < 256) {
+                if (outPos == outEnd) return false;
+                *outPos++ = static_cast<uint8_t>(symbol);
+                continue;
+            }
+            if (symbol == 256) return true;
+
+            symbol -= 257;
+            if (symbol >= 29) return false;
+            size_t len = lengthBase[symbol] + Bits(lengthExtra[symbol]);
+            int distSymbol = Decode(distCodes);
+            if (distSymbol < 0 || distSymbol >= 30) return false;
+            size_t dist = distBase[distSymbol] + Bits(distExtra[distSymbol]);
+            if (overrun) return false;
+            if (dist > static_cast<size_t>(outPos - out) || len > static_cast<size_t>(outEnd - outPos)) return false;
+
+            const uint8_t* from = outPos - dist;
+            for (size_t i = 0; i < len; i++) *outPos++ = from[i];
+        }
+    }
+
+    bool Fixed() {
+        Huffman lengthCodes, distCodes;
+        uint8_t lengths[288];
+        int i = 0;
+        for (; i < 144; i++) lengths[i] = 8;
+        for (; i < 256; i++) lengths[i] = 9;
+        for (; i < 280; i++) lengths[i] = 7;
+        for (; i < 288; i++) lengths[i] = 8;
+        Build(lengthCodes, lengths, 288);
+        for (i = 0; i < 30; i++) lengths[i] = 5;
+        Build(distCodes, lengths, 30);
+        return Codes(lengthCodes, distCodes);
+    }
+
+    bool Dynamic() {
+        static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        int lengthCount = Bits(5) + 257;
+        int distCount = Bits(5) + 1;
+        int codeCount = Bits(4) + 4;
+        if (overrun || lengthCount > 286 || distCount > 30) return false;
+
+        uint8_t lengths[320] = {};
+        for (int i = 0; i < codeCount; i++) lengths[order[i]] = static_cast<uint8_t>(Bits(3));
+        Huffman codeLengths;
+        if (overrun || !Build(codeLengths, lengths, 19)) return false;
+
+        int index = 0;
+        while (index < lengthCount + distCount) {
+            int symbol = Decode(codeLengths);
+            if (symbol < 0) return false;
+            if (symbol < 16) {
+                lengths[index++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+            uint8_t len = 0;
+            int repeat;
+            if (symbol == 16) {
+                if (index == 0) return false;
+                len = lengths[index - 1];
+                repeat = 3 + Bits(2);
+            }
+            else if (symbol == 17) {
+                repeat = 3 + Bits(3);
+            }
+            else {
+                repeat = 11 + Bits(7);
+            }
+            if (overrun || index + repeat > lengthCount + distCount) return false;
+            while (repeat--) lengths[index++] = len;
+        }
+        if (lengths[256] == 0) return false;
+
+        Huffman lengthCodes, distCodes;
+        if (!Build(lengthCodes, lengths, lengthCount) ||
+            !Build(distCodes, lengths + lengthCount, distCount)) return false;
+        return Codes(lengthCodes, distCodes);
+    }
+
+    bool Run() {
+        if (inEnd - in < 6) return false;
+        uint8_t cmf = in[0], flg = in[1];
+        if ((cmf & 0x0F) != 8 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20)) return false;
+        in += 2;
+
+        bool last;
+        do {
+            last = Bits(1) != 0;
+            uint32_t type = Bits(2);
+            if (overrun) return false;
+            bool ok = type == 0 ? Stored() : type == 1 ? Fixed() : type == 2 ? Dynamic() : false;
+            if (!ok || overrun) return false;
+        } while (!last);
+
+        if (outPos != outEnd || inEnd - in < 4) return false;
+        uint32_t expected = (uint32_t(in[0]) << 24) | (uint32_t(in[1]) << 16) | (uint32_t(in[2]) << 8) | in[3];
+        return Adler32(out, outEnd - out) == expected;
+    }
+
+    static uint32_t Adler32(const uint8_t* data, size_t size) {
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+            size_t block = size < 5552 ? size : 5552;
+            size -= block;
+            while (block--) {
+                a += *data++;
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+};
@@ -0,0 +1,117 @@
+﻿#pragma once
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ============================================================================
+// Memory-mapped file (read-only)
+// ============================================================================
+//
+// Borrow wraps bytes that are already in memory instead, e.g. a cache handed
+// to the library API (RizomBridge.h), so readers take either.
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { Close(); }
+
+    bool Open(const std::string& path) {
+        Close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize)) return false;
+        size = static_cast<size_t>(fileSize.QuadPart);
+        if (size == 0) return true;
+
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mappingHandle) return false;
+        data = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) return false;
+        size = static_cast<size_t>(st.st_size);
+        if (size == 0) return true;
+
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) return false;
+        madvise(view, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(view);
+#endif
+        return data != nullptr;
+    }
+
+    // bytes stay owned by the caller and must outlive this object's use.
+    void Borrow(const char* bytes, size_t length) {
+        Close();
+        data = bytes;
+        size = length;
+        borrowed = true;
+    }
+
+    void Close() {
+        if (borrowed) {
+            data = nullptr;
+            size = 0;
+            borrowed = false;
+            return;
+        }
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mappingHandle) CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+        mappingHandle = nullptr;
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (data) munmap(const_cast<char*>(data), size);
+        if (fd >= 0) close(fd);
+        fd = -1;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    bool borrowed = false;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// View into a mapping. Payloads in the cache and in binary FBX files are not
+// aligned, so ints are always read with memcpy.
+struct ByteSpan {
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
@@ -0,0 +1,121 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Flat name table
+// ============================================================================
+//
+// Open-addressing hash table (linear probing, power-of-two capacity) from
+// mesh/node name to a value. Names are interned once on Insert and keep
+// their hash, so a lookup costs one hash of the probe string plus, in the
+// common case, one memcmp. Values are stored densely in insertion order.
+// Names, slots and values come from the memory resource given at
+// construction (the default heap unless a caller passes an arena).
+//
+// References returned by Insert/Find are invalidated by the next Insert.
+
+inline uint64_t HashName(const char* data, size_t len) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+template <typename T>
+class NameTable {
+public:
+    explicit NameTable(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : slots(resource), names(resource), values(resource) {}
+
+    T& Insert(const char* name, size_t len) {
+        uint64_t hash = HashName(name, len);
+        size_t slot = Probe(name, len, hash);
+        if (slots.empty() || slots[slot].entry == kEmpty) {
+            if ((names.size() + 1) * 4 > slots.size() * 3) {
+                Grow();
+                slot = Probe(name, len, hash);
+            }
+            slots[slot] = { hash, static_cast<uint32_t>(names.size()) };
+            names.emplace_back(name, len);
+            values.emplace_back();
+        }
+        return values[slots[slot].entry];
+    }
+
+    T& Insert(const std::string& name) { return Insert(name.data(), name.size()); }
+
+    T* Find(const char* name, size_t len) {
+        if (slots.empty()) return nullptr;
+        size_t slot = Probe(name, len, HashName(name, len));
+        return slots[slot].entry == kEmpty ? nullptr : &values[slots[slot].entry];
+    }
+
+    T* Find(const std::string& name) { return Find(name.data(), name.size()); }
+
+    void Reserve(size_t count) {
+        names.reserve(count);
+        values.reserve(count);
+        if (count * 4 > slots.size() * 3) Rehash(Capacity(count));
+    }
+
+    size_t Size() const { return names.size(); }
+    const std::pmr::string& NameAt(size_t i) const { return names[i]; }
+    T& ValueAt(size_t i) { return values[i]; }
+    const T& ValueAt(size_t i) const { return values[i]; }
+
+private:
+    static const uint32_t kEmpty = 0xFFFFFFFFu;
+
+    struct Slot {
+        uint64_t hash;
+        uint32_t entry;
+    };
+
+    // Slot holding name, or the empty slot where it would go.
+    size_t Probe(const char* name, size_t len, uint64_t hash) const {
+        if (slots.empty()) return 0;
+        size_t mask = slots.size() - 1;
+        size_t slot = static_cast<size_t>(hash) & mask;
+        while (slots[slot].entry != kEmpty) {
+            const Slot& s = slots[slot];
+            if (s.hash == hash) {
+                const std::pmr::string& key = names[s.entry];
+                if (key.size() == len && std::memcmp(key.data(), name, len) == 0) break;
+            }
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    static size_t Capacity(size_t count) {
+        size_t capacity = 16;
+        while (capacity * 3 < count * 4) capacity *= 2;
+        return capacity;
+    }
+
+    void Grow() { Rehash(slots.empty() ? 16 : slots.size() * 2); }
+
+    void Rehash(size_t capacity) {
+        std::pmr::vector<Slot> old(slots.get_allocator());
+        old.swap(slots);
+        slots.assign(capacity, Slot{ 0, kEmpty });
+        size_t mask = capacity - 1;
+        for (const Slot& s : old) {
+            if (s.entry == kEmpty) continue;
+            size_t slot = static_cast<size_t>(s.hash) & mask;
+            while (slots[slot].entry != kEmpty) slot = (slot + 1) & mask;
+            slots[slot] = s;
+        }
+    }
+
+    std::pmr::vector<Slot> slots;
+    std::pmr::vector<std::pmr::string> names;
+    std::pmr::vector<T> values;
+};
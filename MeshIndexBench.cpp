@@ -0,0 +1,125 @@
+﻿#include "MeshIndex.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <cstdlib>
+
+// ============================================================================
+// Mesh lookup microbenchmark
+// ============================================================================
+//
+// Compares the Injector's mesh lookup before and after the flat name index:
+// std::map with count() + operator[] for the node name and then the mesh
+// name, against one NameTable::Find per name. Every tenth scene node has no
+// cache entry, so it also pays the mesh-name fallback.
+//
+// Usage: MeshIndexBench.exe [rounds]
+
+struct BenchGeometry {
+    int islandCount = 0;
+};
+
+double ElapsedNs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct SceneNode {
+    std::string nodeName;
+    std::string meshName;
+};
+
+std::vector<SceneNode> MakeScene(size_t meshCount) {
+    std::vector<SceneNode> nodes(meshCount);
+    for (size_t i = 0; i < meshCount; i++) {
+        nodes[i].nodeName = "SM_Kit_Prop_" + std::to_string(i);
+        nodes[i].meshName = "SM_Kit_Prop_" + std::to_string(i) + "_Mesh";
+        if (i % 10 == 9) nodes[i].nodeName += "_Edited";
+    }
+    std::shuffle(nodes.begin(), nodes.end(), std::mt19937(1234));
+    return nodes;
+}
+
+int LookupMap(std::map<std::string, BenchGeometry>& geometryData, const std::vector<SceneNode>& nodes) {
+    int found = 0;
+    for (const SceneNode& node : nodes) {
+        BenchGeometry* geoData = nullptr;
+        if (geometryData.count(node.nodeName)) {
+            geoData = &geometryData[node.nodeName];
+        }
+        else if (geometryData.count(node.meshName)) {
+            geoData = &geometryData[node.meshName];
+        }
+        if (geoData) found += geoData->islandCount;
+    }
+    return found;
+}
+
+int LookupTable(NameTable<BenchGeometry>& geometryData, const std::vector<SceneNode>& nodes) {
+    int found = 0;
+    for (const SceneNode& node : nodes) {
+        BenchGeometry* geoData = geometryData.Find(node.nodeName);
+        if (!geoData) geoData = geometryData.Find(node.meshName);
+        if (geoData) found += geoData->islandCount;
+    }
+    return found;
+}
+
+void RunSize(size_t meshCount, int rounds) {
+    std::vector<std::string> cacheNames(meshCount);
+    for (size_t i = 0; i < meshCount; i++) {
+        cacheNames[i] = "SM_Kit_Prop_" + std::to_string(i);
+    }
+    std::vector<SceneNode> nodes = MakeScene(meshCount);
+
+    auto start = std::chrono::steady_clock::now();
+    std::map<std::string, BenchGeometry> mapData;
+    for (const std::string& name : cacheNames) mapData[name].islandCount = 1;
+    double mapBuildNs = ElapsedNs(start);
+
+    start = std::chrono::steady_clock::now();
+    NameTable<BenchGeometry> tableData;
+    for (const std::string& name : cacheNames) tableData.Insert(name).islandCount = 1;
+    double tableBuildNs = ElapsedNs(start);
+
+    int mapFound = 0, tableFound = 0;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) mapFound += LookupMap(mapData, nodes);
+    double mapLookupNs = ElapsedNs(start) / (static_cast<double>(rounds) * meshCount);
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) tableFound += LookupTable(tableData, nodes);
+    double tableLookupNs = ElapsedNs(start) / (static_cast<double>(rounds) * meshCount);
+
+    if (mapFound != tableFound) {
+        std::cerr << "Mismatch at " << meshCount << " meshes: " << mapFound << " vs " << tableFound << std::endl;
+    }
+
+    std::cout << std::setw(8) << meshCount
+        << std::fixed << std::setprecision(2)
+        << std::setw(14) << mapBuildNs / 1e6
+        << std::setw(14) << tableBuildNs / 1e6
+        << std::setw(14) << mapLookupNs
+        << std::setw(14) << tableLookupNs
+        << std::setw(10) << mapLookupNs / tableLookupNs << "x" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int rounds = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+
+    std::cout << std::setw(8) << "meshes"
+        << std::setw(14) << "map build ms"
+        << std::setw(14) << "flat build ms"
+        << std::setw(14) << "map ns/node"
+        << std::setw(14) << "flat ns/node"
+        << std::setw(11) << "speedup" << std::endl;
+
+    for (size_t meshCount : { 1000, 10000, 100000 }) {
+        RunSize(meshCount, rounds);
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+﻿#pragma once
+#include <fstream>
+#include <regex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// ============================================================================
+// Mesh name filters
+// ============================================================================
+//
+// --include / --exclude select meshes by node or mesh name, so a tool only
+// touches the objects it was asked for. A pattern is a glob (* ? [abc]
+// [!abc]) unless it starts with "re:", which makes the rest an ECMAScript
+// regex matched against the whole name, or with '=', which makes the rest a
+// literal name (for names containing * ? or [). --filter-file reads one
+// pattern per line: "!pattern" excludes, '#' starts a comment, blank lines
+// are skipped.
+//
+// A mesh is selected when no include is given or one matches its node or
+// mesh name, and no exclude matches either. Patterns without wildcards are
+// kept in a hash set, so a file listing thousands of object names costs one
+// lookup per name.
+
+class NameFilter {
+public:
+    bool Add(const std::string& pattern, bool exclude, std::string& error) {
+        PatternSet& set = exclude ? excludes : includes;
+        if (pattern.compare(0, 3, "re:") == 0) {
+            try {
+                set.regexes.emplace_back(pattern.substr(3), std::regex::ECMAScript | std::regex::optimize);
+            }
+            catch (const std::regex_error& e) {
+                error = "invalid regex '" + pattern.substr(3) + "': " + e.what();
+                return false;
+            }
+        }
+        else if (!pattern.empty() && pattern[0] == '=') {
+            set.names.insert(pattern.substr(1));
+        }
+        else if (pattern.find_first_of("*?[") == std::string::npos) {
+            set.names.insert(pattern);
+        }
+        else {
+            set.globs.push_back(pattern);
+        }
+        return true;
+    }
+
+    bool LoadFile(const std::string& path, std::string& error) {
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            error = "could not open filter file " + path;
+            return false;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+            bool exclude = line[0] == '!';
+            if (!Add(exclude ? line.substr(1) : line, exclude, error)) return false;
+        }
+        return true;
+    }
+
+    bool Empty() const { return includes.Empty() && excludes.Empty(); }
+
+    bool Selects(const std::string& nodeName, const std::string& meshName) const {
+        if (Empty()) return true;
+        if (!includes.Empty() && !includes.Matches(nodeName) && !includes.Matches(meshName)) return false;
+        return !excludes.Matches(nodeName) && !excludes.Matches(meshName);
+    }
+
+private:
+    struct PatternSet {
+        std::unordered_set<std::string> names;
+        std::vector<std::string> globs;
+        std::vector<std::regex> regexes;
+
+        bool Empty() const { return names.empty() && globs.empty() && regexes.empty(); }
+
+        bool Matches(const std::string& name) const {
+            if (names.count(name)) return true;
+            for (const std::string& glob : globs) {
+                if (GlobMatch(glob, name)) return true;
+            }
+            for (const std::regex& regex : regexes) {
+                if (std::regex_match(name, regex)) return true;
+            }
+            return false;
+        }
+    };
+
+    // [...] at pattern[p]: advances p past it and reports whether c is in it.
+    static bool MatchClass(const std::string& pattern, size_t& p, char c) {
+        size_t i = p + 1;
+        bool negate = i < pattern.size() && pattern[i] == '!';
+        if (negate) i++;
+        bool found = false;
+        for (size_t first = i; i < pattern.size() && (pattern[i] != ']' || i == first); i++) {
+            if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+                found |= pattern[i] <= c && c <= pattern[i + 2];
+                i += 2;
+            }
+            else {
+                found |= pattern[i] == c;
+            }
+        }
+        p = i < pattern.size() ? i + 1 : pattern.size();
+        return found != negate;
+    }
+
+    // Iterative glob match: on a mismatch, the last '*' takes one more char.
+    static bool GlobMatch(const std::string& pattern, const std::string& name) {
+        size_t p = 0, n = 0, starP = std::string::npos, starN = 0;
+        while (n < name.size()) {
+            if (p < pattern.size() && pattern[p] == '*') {
+                starP = ++p;
+                starN = n;
+                continue;
+            }
+            size_t next = p;
+            bool matched = false;
+            if (p < pattern.size()) {
+                if (pattern[p] == '[') matched = MatchClass(pattern, next, name[n]);
+                else {
+                    matched = pattern[p] == '?' || pattern[p] == name[n];
+                    next = p + 1;
+                }
+            }
+            if (matched) {
+                p = next;
+                n++;
+            }
+            else if (starP != std::string::npos) {
+                p = starP;
+                n = ++starN;
+            }
+            else {
+                return false;
+            }
+        }
+        while (p < pattern.size() && pattern[p] == '*') p++;
+        return p == pattern.size();
+    }
+
+    PatternSet includes;
+    PatternSet excludes;
+};
+
+// --include / --exclude / --filter-file; true if argv[i] was one of them.
+// error is set if the pattern or file is invalid.
+inline bool ParseNameFilterFlag(int argc, const char* const* argv, int& i, NameFilter& filter, std::string& error) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) return false;
+    if (arg == "--include" || arg == "--exclude") {
+        std::string patternError;
+        if (!filter.Add(argv[++i], arg == "--exclude", patternError)) error = patternError;
+    }
+    else if (arg == "--filter-file") {
+        std::string fileError;
+        if (!filter.LoadFile(argv[++i], fileError)) error = fileError;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,463 @@
+﻿#pragma once
+#include "ExtractRecords.h"
+#include "FbxBinary.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// Native extraction (binary FBX, no SDK)
+// ============================================================================
+//
+// Produces the same cache as the SDK backend by scanning the node records
+// of a binary FBX 7.x file directly:
+//
+//   Documents/Document/Properties70     -> RizomUV document properties
+//   Objects/Geometry (Mesh)             -> RizomUV, RizomUVUVSets, layer user data,
+//                                          PolygonVertexIndex (topology fingerprint),
+//                                          Vertices (polygon samples, --remap-data only)
+//   Objects/Model, Connections "OO"     -> node names and node order
+//
+// Everything else, vertices included, is skipped by endOffset without being
+// read. Geometry arrays are inflated on the encode threads.
+// Meshes come out in Model order, which is the order the SDK importer
+// creates scene nodes in; a node's mesh is its first connected attribute.
+
+// Short SDK name of a hierarchical property: "RizomUV|UVSets" -> "UVSets".
+inline std::string NativePropertyShortName(const std::string& name) {
+    size_t separator = name.rfind('|');
+    return separator == std::string::npos ? name : name.substr(separator + 1);
+}
+
+// Values as the SDK reports them: the type and label pick the tag
+// (PropertyType.h), and numbers are converted to its element type, so a
+// value stored as 'I' where the SDK would write 'D' reads the same.
+inline PropertySnapshot NativeSnapshotProperty(FbxRecordScanner& scanner, const FbxRecordView& p) {
+    PropertySnapshot snap;
+    FbxPropertyCursor cursor(p.properties);
+    FbxPropertyValue name, type, label, flags, value;
+    cursor.Next(name);
+    cursor.Next(type);
+    cursor.Next(label);
+    cursor.Next(flags);
+    bool hasValue = cursor.Next(value);
+
+    snap.propName = NativePropertyShortName(FbxPropertyString(name));
+    snap.typeName = FbxPropertyString(type);
+    snap.type = PropertyTypeFromFbx(snap.typeName, FbxPropertyString(label));
+    const PropertyTypeInfo& info = GetPropertyTypeInfo(snap.type);
+
+    if (snap.type == kPropertyNone) {
+        return snap;
+    }
+    else if (PropertyValueSize(snap.type) != 0) {
+        // Missing trailing values read as zero.
+        for (uint8_t i = 0; i < info.elementCount; i++) {
+            if (!hasValue) value = FbxPropertyValue();
+            AppendPropertyElement(snap.bytes, snap.type, value.integer, value.real, value.type == 'F' || value.type == 'D');
+            hasValue = hasValue && cursor.Next(value);
+        }
+    }
+    else if (info.kind == kValueBlob) {
+        FbxRecordScanner children = scanner.Children(p);
+        FbxRecordView child;
+        FbxPropertyValue blob;
+        while (children.Next(child)) {
+            if (child.Is("BinaryData") && GetFbxProperty(child.properties, 0, blob)) {
+                snap.bytes.assign(blob.data.data, blob.data.size);
+                break;
+            }
+        }
+    }
+    else {
+        // FbxString stops at the first NUL, so the SDK path does too.
+        if (hasValue) snap.bytes = FbxPropertyString(value).c_str();
+    }
+    return snap;
+}
+
+// P records of a Properties70 record, by full name.
+inline std::unordered_map<std::string, FbxRecordView> NativeReadProperties70(
+    FbxRecordScanner& scanner, const FbxRecordView& owner) {
+    std::unordered_map<std::string, FbxRecordView> properties;
+    FbxRecordScanner children = scanner.Children(owner);
+    FbxRecordView child;
+    while (children.Next(child)) {
+        if (!child.Is("Properties70")) continue;
+        FbxRecordScanner list = scanner.Children(child);
+        FbxRecordView p;
+        FbxPropertyValue name;
+        while (list.Next(p)) {
+            if (p.Is("P") && GetFbxProperty(p.properties, 0, name)) {
+                properties.emplace(FbxPropertyString(name), p);
+            }
+        }
+    }
+    return properties;
+}
+
+inline void NativeExtractDocument(FbxRecordScanner& scanner, const FbxRecordView* documents,
+    std::vector<PropertySnapshot>& properties) {
+    if (!documents) return;
+    FbxRecordScanner list = scanner.Children(*documents);
+    FbxRecordView document;
+    while (list.Next(document) && !document.Is("Document")) {}
+    if (!document.name || !document.Is("Document")) return;
+
+    std::unordered_map<std::string, FbxRecordView> props = NativeReadProperties70(scanner, document);
+    static const char* const chain[] = {
+        "RizomUV", "RizomUV|Scene", "RizomUV|UVSets", "RizomUV|UVSets|UVMap", "RizomUV|UVSets|UVMap|RootGroup" };
+
+    // Scene is optional; UVSets, UVMap and RootGroup each need the one before.
+    for (int i = 0; i < 5; i++) {
+        auto it = props.find(chain[i]);
+        if (it == props.end()) {
+            if (i == 1) continue;
+            break;
+        }
+        properties.push_back(NativeSnapshotProperty(scanner, it->second));
+    }
+}
+
+// One UserDataArray of an element, its values left undecoded.
+struct NativeUserDataArray {
+    std::string name;
+    std::string typeName;
+    FbxPropertyValue values;
+    bool hasValues = false;
+};
+
+// User data element of one geometry; geometries list them in layer order.
+// Only RizomUV elements get their arrays read.
+struct NativeUserData {
+    std::string name;
+    uint32_t layer = 0;
+    uint8_t mapping = kMappingNone;
+    uint8_t reference = kReferenceDirect;
+    std::vector<NativeUserDataArray> arrays;
+};
+
+// Arrays of one geometry still to be decoded.
+struct NativeMeshArrays {
+    std::vector<NativeUserData> userData;
+    FbxPropertyValue polygonIndices;
+    bool hasPolygonIndices = false;
+    FbxPropertyValue vertices;
+    bool hasVertices = false;
+};
+
+inline void NativeReadGeometry(FbxRecordScanner& scanner, const FbxRecordView& geometry,
+    MeshSnapshot& snap, NativeMeshArrays& arrays) {
+    std::vector<NativeUserData>& userData = arrays.userData;
+    std::unordered_map<std::string, FbxRecordView> props = NativeReadProperties70(scanner, geometry);
+    for (const char* name : { "RizomUV", "RizomUVUVSets" }) {
+        auto it = props.find(name);
+        if (it != props.end()) snap.properties.push_back(NativeSnapshotProperty(scanner, it->second));
+    }
+
+    // Layer index -> TypedIndex of its user data element, and the elements themselves.
+    std::vector<std::pair<int64_t, int64_t>> layers;
+    std::unordered_map<int64_t, FbxRecordView> elements;
+    FbxRecordScanner children = scanner.Children(geometry);
+    FbxRecordView child;
+    FbxPropertyValue index;
+    while (children.Next(child)) {
+        if (child.Is("LayerElementUserData") && GetFbxProperty(child.properties, 0, index)) {
+            elements.emplace(index.integer, child);
+        }
+        else if (child.Is("PolygonVertexIndex") && !arrays.hasPolygonIndices) {
+            arrays.hasPolygonIndices = GetFbxProperty(child.properties, 0, arrays.polygonIndices);
+        }
+        else if (child.Is("Vertices") && !arrays.hasVertices) {
+            arrays.hasVertices = GetFbxProperty(child.properties, 0, arrays.vertices);
+        }
+        else if (child.Is("Layer") && GetFbxProperty(child.properties, 0, index)) {
+            FbxRecordScanner layerChildren = scanner.Children(child);
+            FbxRecordView element;
+            while (layerChildren.Next(element)) {
+                if (!element.Is("LayerElement")) continue;
+                FbxRecordScanner fields = scanner.Children(element);
+                FbxRecordView field;
+                FbxPropertyValue value;
+                bool isUserData = false;
+                int64_t typedIndex = 0;
+                while (fields.Next(field)) {
+                    if (field.Is("Type") && GetFbxProperty(field.properties, 0, value)) {
+                        isUserData = FbxPropertyString(value) == "LayerElementUserData";
+                    }
+                    else if (field.Is("TypedIndex") && GetFbxProperty(field.properties, 0, value)) {
+                        typedIndex = value.integer;
+                    }
+                }
+                if (isUserData) {
+                    layers.push_back({ index.integer, typedIndex });
+                    break;
+                }
+            }
+        }
+    }
+    std::stable_sort(layers.begin(), layers.end());
+
+    for (const auto& layer : layers) {
+        auto it = elements.find(layer.second);
+        if (it == elements.end()) continue;
+
+        userData.emplace_back();
+        NativeUserData& data = userData.back();
+        data.layer = static_cast<uint32_t>(layer.first);
+        std::vector<FbxRecordView> arrayRecords;
+        FbxRecordScanner fields = scanner.Children(it->second);
+        FbxRecordView field;
+        FbxPropertyValue value;
+        while (fields.Next(field)) {
+            if (field.Is("Name") && GetFbxProperty(field.properties, 0, value)) {
+                data.name = FbxPropertyString(value);
+            }
+            else if (field.Is("MappingInformationType") && GetFbxProperty(field.properties, 0, value)) {
+                data.mapping = UserDataMappingFromFbx(FbxPropertyString(value));
+            }
+            else if (field.Is("ReferenceInformationType") && GetFbxProperty(field.properties, 0, value)) {
+                data.reference = UserDataReferenceFromFbx(FbxPropertyString(value));
+            }
+            else if (field.Is("UserDataArray")) {
+                arrayRecords.push_back(field);
+            }
+        }
+        if (!IsRizomUserData(data.name)) continue;
+
+        for (const FbxRecordView& arrayRecord : arrayRecords) {
+            data.arrays.emplace_back();
+            NativeUserDataArray& array = data.arrays.back();
+            FbxRecordScanner arrayFields = scanner.Children(arrayRecord);
+            FbxRecordView arrayField;
+            while (arrayFields.Next(arrayField)) {
+                if (arrayField.Is("UserDataType") && GetFbxProperty(arrayField.properties, 0, value)) {
+                    array.typeName = FbxPropertyString(value);
+                }
+                else if (arrayField.Is("UserDataName") && GetFbxProperty(arrayField.properties, 0, value)) {
+                    array.name = FbxPropertyString(value);
+                }
+                else if (arrayField.Is("UserData") && !array.hasValues) {
+                    array.hasValues = GetFbxProperty(arrayField.properties, 0, array.values);
+                }
+            }
+        }
+    }
+}
+
+// Fills the snapshots the SDK backend would take from an imported scene.
+// Snapshots do not point into file, so it may be closed afterwards.
+// Meshes options.filter leaves out are dropped before any of their records
+// are read.
+inline bool ScanNativeScene(const MappedFile& file, const ExtractOptions& options,
+    std::vector<PropertySnapshot>& documentProperties, std::vector<MeshSnapshot>& meshes, std::string& error) {
+    ScopedPhase phase("scan");
+    FbxRecordScanner scanner;
+    if (!scanner.Open(file.Data(), file.Size(), error)) {
+        error += " (the native backend reads binary FBX only)";
+        return false;
+    }
+
+    FbxRecordView top, documents, objects, connections;
+    bool hasDocuments = false, hasObjects = false, hasConnections = false;
+    while (scanner.Next(top)) {
+        if (top.Is("Documents")) { documents = top; hasDocuments = true; }
+        else if (top.Is("Objects")) { objects = top; hasObjects = true; }
+        else if (top.Is("Connections")) { connections = top; hasConnections = true; }
+    }
+
+    // Attribute ids (mesh geometry -> index, anything else -> -1) and models.
+    struct NativeGeometry { FbxRecordView record; std::string name; };
+    struct NativeModel { int64_t id; std::string name; int64_t attribute; bool hasAttribute; };
+    std::vector<NativeGeometry> geometries;
+    std::unordered_map<int64_t, int64_t> attributes;
+    std::vector<NativeModel> models;
+    std::unordered_map<int64_t, size_t> modelIndex;
+    if (hasObjects) {
+        FbxRecordScanner list = scanner.Children(objects);
+        FbxRecordView object;
+        while (list.Next(object)) {
+            FbxPropertyValue id, name, subclass;
+            if (!GetFbxProperty(object.properties, 0, id) || !GetFbxProperty(object.properties, 1, name)) continue;
+            GetFbxProperty(object.properties, 2, subclass);
+
+            if (object.Is("Geometry") && FbxPropertyString(subclass) == "Mesh") {
+                attributes[id.integer] = static_cast<int64_t>(geometries.size());
+                geometries.push_back({ object, FbxObjectName(name) });
+            }
+            else if (object.Is("Geometry") || object.Is("NodeAttribute")) {
+                attributes[id.integer] = -1;
+            }
+            else if (object.Is("Model")) {
+                modelIndex[id.integer] = models.size();
+                models.push_back({ id.integer, FbxObjectName(name), -1, false });
+            }
+        }
+        if (list.Failed()) {
+            error = "malformed Objects record";
+            return false;
+        }
+    }
+    if (hasConnections) {
+        FbxRecordScanner list = scanner.Children(connections);
+        FbxRecordView c;
+        while (list.Next(c)) {
+            FbxPropertyValue type, child, parent;
+            if (!c.Is("C") || !GetFbxProperty(c.properties, 0, type) || FbxPropertyString(type) != "OO" ||
+                !GetFbxProperty(c.properties, 1, child) || !GetFbxProperty(c.properties, 2, parent)) continue;
+            auto attribute = attributes.find(child.integer);
+            auto model = modelIndex.find(parent.integer);
+            if (attribute == attributes.end() || model == modelIndex.end()) continue;
+            NativeModel& node = models[model->second];
+            if (!node.hasAttribute) {
+                node.attribute = attribute->second;
+                node.hasAttribute = true;
+            }
+        }
+    }
+    if (scanner.Failed()) {
+        error = "malformed node record";
+        return false;
+    }
+
+    NativeExtractDocument(scanner, hasDocuments ? &documents : nullptr, documentProperties);
+
+    std::vector<NativeMeshArrays> pending;
+    size_t filtered = 0;
+    for (const NativeModel& model : models) {
+        if (!model.hasAttribute || model.attribute < 0) continue;
+        const NativeGeometry& geometry = geometries[static_cast<size_t>(model.attribute)];
+        if (!options.filter.Selects(model.name, geometry.name)) {
+            ++filtered;
+            continue;
+        }
+        meshes.emplace_back();
+        pending.emplace_back();
+        meshes.back().nodeName = model.name;
+        meshes.back().meshName = geometry.name;
+        NativeReadGeometry(scanner, geometry.record, meshes.back(), pending.back());
+    }
+
+    // Inflating is the only real work left, so it runs on the encode threads.
+    std::atomic<bool> arraysOk(true);
+    bool samplePolygons = options.remapData;
+    ParallelFor(meshes.size(), options.threadCount, [&](size_t i) {
+        ScopedPhase meshPhase("inflate_mesh", meshes[i].nodeName);
+        for (const NativeUserData& data : pending[i].userData) {
+            meshes[i].userData.emplace_back();
+            UserDataSnapshot& snap = meshes[i].userData.back();
+            snap.name = data.name;
+            snap.layer = data.layer;
+            snap.mapping = data.mapping;
+            snap.reference = data.reference;
+            for (const NativeUserDataArray& array : data.arrays) {
+                snap.arrays.emplace_back();
+                UserDataArraySnapshot& arraySnap = snap.arrays.back();
+                arraySnap.name = array.name;
+                arraySnap.typeName = array.typeName;
+                arraySnap.type = PropertyTypeFromFbx(array.typeName, std::string());
+                if (!IsUserDataType(arraySnap.type) || !array.hasValues) continue;
+                if (array.values.type != UserDataArrayCode(arraySnap.type)) {
+                    // Left to EncodeUserData to skip with a warning.
+                    arraySnap.typeName += std::string(" stored as '") + array.values.type + "'";
+                    arraySnap.type = kPropertyNone;
+                    continue;
+                }
+
+                size_t valueSize = PropertyValueSize(arraySnap.type);
+                arraySnap.storage.resize(array.values.arrayLength * valueSize);
+                bool decoded = valueSize == 1 ? ReadFbxArray8(array.values, arraySnap.storage.data()) :
+                    valueSize == 4 ? ReadFbxArray32(array.values, arraySnap.storage.data()) :
+                    ReadFbxArray64(array.values, arraySnap.storage.data());
+                if (!decoded) {
+                    arraysOk = false;
+                    arraySnap.storage.clear();
+                }
+                arraySnap.data = arraySnap.storage.data();
+                arraySnap.count = arraySnap.storage.size() / valueSize;
+                meshPhase.Count("values", arraySnap.count);
+            }
+        }
+
+        // A mesh without polygons fingerprints as empty, like the SDK reports it.
+        if (!CarriesRizomData(meshes[i])) return;
+        const NativeMeshArrays& arrays = pending[i];
+        FbxTopologyBuilder topology;
+        if (samplePolygons && arrays.hasPolygonIndices && arrays.hasVertices && HasRizomUserData(meshes[i])) {
+            // Samples need the whole index array, so it is decoded once for both.
+            std::vector<int> indices(arrays.polygonIndices.arrayLength);
+            std::vector<double> points(arrays.vertices.arrayLength);
+            if (!ReadFbxArray32(arrays.polygonIndices, indices.data()) || !ReadFbxArray64(arrays.vertices, points.data())) {
+                arraysOk = false;
+                return;
+            }
+            PolygonSampler sampler(points.data(), 3, points.size() / 3);
+            meshes[i].hasSamples = SampleFbxPolygons(sampler, indices.data(), indices.size(), meshes[i].samples);
+            if (!meshes[i].hasSamples) meshes[i].samples.clear();
+            topology.Add(indices.data(), indices.size());
+        }
+        else if (arrays.hasPolygonIndices &&
+            !ForEachFbxIntChunk(arrays.polygonIndices, [&](int32_t* chunk, size_t count) { topology.Add(chunk, count); })) {
+            arraysOk = false;
+            return;
+        }
+        meshes[i].hasTopology = topology.Finish(meshes[i].topology);
+    });
+    phase.Count("meshes", meshes.size());
+    phase.Count("filtered", filtered);
+    phase.Count("bytes", file.Size());
+    if (!arraysOk) {
+        error = "could not decode a geometry array";
+        return false;
+    }
+    return true;
+}
+
+// Writes the cache into outFile, opened by the caller and closed on success.
+inline int ExtractNativeToCache(const char* inputFBX, CacheWriter& outFile,
+    const ExtractOptions& options, std::string& error) {
+    auto scanStart = std::chrono::steady_clock::now();
+    std::vector<PropertySnapshot> documentProperties;
+    std::vector<MeshSnapshot> meshes;
+    {
+        MappedFile file;
+        if (!file.Open(inputFBX)) {
+            error = std::string("Could not open FBX file: ") + inputFBX;
+            return 1;
+        }
+        if (!ScanNativeScene(file, options, documentProperties, meshes, error)) {
+            error = std::string("Could not read ") + inputFBX + ": " + error;
+            return 1;
+        }
+    }
+    BRIDGE_LOG("Scanned " << meshes.size() << " meshes in " << ElapsedMs(scanStart) << " ms");
+
+    BRIDGE_LOG("\n=== Extracting RizomUV data from FbxDocument ===");
+    WriteDocumentBlock(outFile, documentProperties);
+    BRIDGE_LOG("\n=== Extracting RizomUV data from Geometries ===");
+    WriteMeshBlocks(outFile, meshes, options.threadCount, options.compactIds);
+    return 0;
+}
+
+inline int RunNativeExtraction(const char* inputFBX, const char* outputDAT,
+    const ExtractOptions& options, std::string& error) {
+    CacheWriter outFile;
+    if (!outFile.Open(outputDAT)) {
+        error = std::string("Could not open output file: ") + outputDAT;
+        return 1;
+    }
+    if (ExtractNativeToCache(inputFBX, outFile, options, error) != 0) return 1;
+    ScopedPhase closePhase("cache_close");
+    if (!outFile.Close()) {
+        error = std::string("Could not write output file: ") + outputDAT;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+﻿#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Value of a --threads or --jobs flag: 0 means all cores.
+inline unsigned ThreadCountArg(const char* arg) {
+    int threads = std::atoi(arg);
+    return threads > 0 ? static_cast<unsigned>(threads) : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Runs fn(0..count-1) on up to threadCount threads; inline when threadCount <= 1.
+template <typename Fn>
+inline void ParallelFor(size_t count, unsigned threadCount, Fn fn) {
+    threadCount = static_cast<unsigned>(std::min<size_t>(threadCount, count));
+    if (threadCount <= 1) {
+        for (size_t i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threadCount; t++) {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < count; i = next++) fn(i);
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+}
@@ -0,0 +1,179 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// ============================================================================
+// Property types
+// ============================================================================
+//
+// The value types RizomUV properties can carry, as one-byte tags stored in
+// v4 cache records (kRecordFlagTypeTag, CacheFormat.h). Everything that
+// encodes or decodes a value looks its layout up in kPropertyTypes by tag:
+//
+//   cache value  fixed: elementCount x elementSize bytes, little-endian
+//                variable (elementSize 0): uint32 length + bytes
+//   Properties70 "name", fbxType, fbxLabel, flags, then elementCount values
+//                written as kind says (blobs go in a BinaryData child)
+//
+// Tags are part of the cache format: append new ones, never renumber.
+
+enum PropertyType : uint8_t {
+    kPropertyNone = 0,
+    kPropertyBool = 1,
+    kPropertyInt = 2,
+    kPropertyEnum = 3,
+    kPropertyULongLong = 4,
+    kPropertyTime = 5,
+    kPropertyFloat = 6,
+    kPropertyDouble = 7,
+    kPropertyVector3 = 8,
+    kPropertyVector4 = 9,
+    kPropertyColor3 = 10,
+    kPropertyColor4 = 11,
+    kPropertyString = 12,
+    kPropertyUrl = 13,
+    kPropertyBlob = 14,
+    kPropertyTypeCount
+};
+
+enum PropertyValueKind : uint8_t {
+    kValueInteger,  // FBX 'I', or 'L' for 8-byte elements
+    kValueReal,     // FBX 'D'
+    kValueString,   // FBX 'S', cut at the first NUL like FbxString
+    kValueBlob,     // FBX 'R' in a BinaryData child
+};
+
+struct PropertyTypeInfo {
+    const char* name;      // FbxDataType name, also the v1-v3 cache type name
+    const char* fbxType;   // Properties70 type and label
+    const char* fbxLabel;
+    PropertyValueKind kind;
+    uint8_t elementSize;   // 0: length-prefixed
+    uint8_t elementCount;
+};
+
+const PropertyTypeInfo kPropertyTypes[kPropertyTypeCount] = {
+    { "",              "",              "",        kValueInteger, 0, 0 },
+    { "Bool",          "bool",          "",        kValueInteger, 1, 1 },
+    { "Integer",       "int",           "Integer", kValueInteger, 4, 1 },
+    { "Enum",          "enum",          "",        kValueInteger, 4, 1 },
+    { "ULongLong",     "ULongLong",     "",        kValueInteger, 8, 1 },
+    { "Time",          "KTime",         "Time",    kValueInteger, 8, 1 },
+    { "Float",         "float",         "",        kValueReal,    4, 1 },
+    { "Number",        "double",        "Number",  kValueReal,    8, 1 },
+    { "Vector3D",      "Vector3D",      "Vector",  kValueReal,    8, 3 },
+    { "Vector4D",      "Vector4D",      "",        kValueReal,    8, 4 },
+    { "Color",         "ColorRGB",      "Color",   kValueReal,    8, 3 },
+    { "ColorAndAlpha", "ColorAndAlpha", "",        kValueReal,    8, 4 },
+    { "KString",       "KString",       "",        kValueString,  0, 1 },
+    { "Url",           "KString",       "Url",     kValueString,  0, 1 },
+    { "Blob",          "Blob",          "",        kValueBlob,    0, 1 },
+};
+
+// Other spellings of the same types: older cache type names and
+// Properties70 types written without a label.
+struct PropertyTypeAlias {
+    const char* name;
+    PropertyType type;
+};
+
+const PropertyTypeAlias kPropertyTypeAliases[] = {
+    { "Int", kPropertyInt },
+    { "String", kPropertyString },
+    { "Vector", kPropertyVector3 },
+    { "Double", kPropertyDouble },
+};
+
+inline bool IsPropertyType(uint8_t tag) {
+    return tag != kPropertyNone && tag < kPropertyTypeCount;
+}
+
+inline const PropertyTypeInfo& GetPropertyTypeInfo(PropertyType type) {
+    return kPropertyTypes[IsPropertyType(type) ? type : kPropertyNone];
+}
+
+// Size of a fixed value in the cache, 0 for length-prefixed ones.
+inline size_t PropertyValueSize(PropertyType type) {
+    const PropertyTypeInfo& info = GetPropertyTypeInfo(type);
+    return static_cast<size_t>(info.elementSize) * info.elementCount;
+}
+
+inline bool PropertyNameIs(const char* name, const char* data, size_t len) {
+    return std::strlen(name) == len && std::memcmp(name, data, len) == 0;
+}
+
+// Type of a v1-v3 record, which stores the type name (the SDK's, or an alias).
+inline PropertyType PropertyTypeFromName(const char* data, size_t len) {
+    for (uint8_t tag = 1; tag < kPropertyTypeCount; tag++) {
+        if (PropertyNameIs(kPropertyTypes[tag].name, data, len)) return static_cast<PropertyType>(tag);
+    }
+    for (const PropertyTypeAlias& alias : kPropertyTypeAliases) {
+        if (PropertyNameIs(alias.name, data, len)) return alias.type;
+    }
+    return kPropertyNone;
+}
+
+// Type of a Properties70 P record: type and label first, so "KString"/"Url"
+// stays a URL, then the type alone, then the aliases.
+inline PropertyType PropertyTypeFromFbx(const std::string& fbxType, const std::string& fbxLabel) {
+    PropertyType byType = kPropertyNone;
+    for (uint8_t tag = 1; tag < kPropertyTypeCount; tag++) {
+        const PropertyTypeInfo& info = kPropertyTypes[tag];
+        if (fbxType != info.fbxType) continue;
+        if (fbxLabel == info.fbxLabel) return static_cast<PropertyType>(tag);
+        if (byType == kPropertyNone) byType = static_cast<PropertyType>(tag);
+    }
+    if (byType != kPropertyNone) return byType;
+    return PropertyTypeFromName(fbxType.data(), fbxType.size());
+}
+
+// ============================================================================
+// Fixed-size elements
+// ============================================================================
+
+// Appends one element of a fixed value, converted from whichever of integer
+// or real the source holds.
+inline void AppendPropertyElement(std::string& out, PropertyType type, int64_t integer, double real, bool isReal) {
+    const PropertyTypeInfo& info = GetPropertyTypeInfo(type);
+    if (info.kind == kValueReal) {
+        double value = isReal ? real : static_cast<double>(integer);
+        if (info.elementSize == sizeof(float)) {
+            float narrow = static_cast<float>(value);
+            out.append(reinterpret_cast<const char*>(&narrow), sizeof(narrow));
+        }
+        else {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+        return;
+    }
+    int64_t value = isReal ? static_cast<int64_t>(real) : integer;
+    if (type == kPropertyBool) value = value != 0;
+    out.append(reinterpret_cast<const char*>(&value), info.elementSize);
+}
+
+// Element i of a fixed value, sign-extended.
+inline int64_t ReadIntegerElement(PropertyType type, const char* data, size_t i) {
+    const PropertyTypeInfo& info = GetPropertyTypeInfo(type);
+    const char* element = data + i * info.elementSize;
+    switch (info.elementSize) {
+    case 1: { int8_t v; std::memcpy(&v, element, 1); return v; }
+    case 4: { int32_t v; std::memcpy(&v, element, 4); return v; }
+    case 8: { int64_t v; std::memcpy(&v, element, 8); return v; }
+    default: return 0;
+    }
+}
+
+inline double ReadRealElement(PropertyType type, const char* data, size_t i) {
+    const PropertyTypeInfo& info = GetPropertyTypeInfo(type);
+    const char* element = data + i * info.elementSize;
+    if (info.elementSize == sizeof(float)) {
+        float v;
+        std::memcpy(&v, element, sizeof(v));
+        return v;
+    }
+    double v;
+    std::memcpy(&v, element, sizeof(v));
+    return v;
+}
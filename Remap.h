@@ -0,0 +1,321 @@
+﻿#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// ============================================================================
+// Island ID remapping
+// ============================================================================
+//
+// Island group IDs are stored per polygon, so they are lost as soon as a mesh
+// is edited after extraction. With polygon samples in the cache ('P' records,
+// Extractor --remap-data) the Injector can carry them over instead: every
+// polygon of the edited mesh takes the ID of the nearest cached polygon that
+// faces the same way.
+//
+//   sample  centroid (mean of the polygon's points) and unit normal (Newell),
+//           in mesh space, as floats
+//   grid    cached samples bucketed in a dense uniform grid (CSR layout); the
+//           cell size follows the typical distance between neighbouring
+//           polygons, grown where needed to stay within kCellsPerSample
+//           cells per sample
+//   query   rings of cells around the polygon's cell, outward, until no
+//           closer sample can exist. A polygon facing away (normal dot below
+//           kRemapMinNormalDot) is only used when nothing facing the same way
+//           is within two rings of it. Polygons more than kRemapMaxRings
+//           cells away from any cached one (new, detached geometry) fall
+//           back to a linear scan.
+
+struct PolygonSample {
+    float centroid[3];
+    float normal[3];
+};
+
+static_assert(sizeof(PolygonSample) == 6 * sizeof(float), "PolygonSample is stored as is in 'P' records");
+
+const float kRemapMinNormalDot = 0.5f;
+const int64_t kRemapMaxRings = 8;
+
+// Samples polygons over points with pointStride doubles per point (x, y, z
+// first; 4 for FbxVector4).
+class PolygonSampler {
+public:
+    PolygonSampler(const double* points, size_t pointStride, size_t pointCount)
+        : points(points), pointStride(pointStride), pointCount(pointCount) {}
+
+    // Fails on an index outside the point array.
+    bool Sample(const int* polygon, int size, PolygonSample& sample) const {
+        double centroid[3] = { 0.0, 0.0, 0.0 }, normal[3] = { 0.0, 0.0, 0.0 };
+        for (int k = 0; k < size; k++) {
+            int next = polygon[k + 1 < size ? k + 1 : 0];
+            if (polygon[k] < 0 || static_cast<size_t>(polygon[k]) >= pointCount ||
+                next < 0 || static_cast<size_t>(next) >= pointCount) return false;
+            const double* p = points + static_cast<size_t>(polygon[k]) * pointStride;
+            const double* q = points + static_cast<size_t>(next) * pointStride;
+            centroid[0] += p[0];
+            centroid[1] += p[1];
+            centroid[2] += p[2];
+            normal[0] += (p[1] - q[1]) * (p[2] + q[2]);
+            normal[1] += (p[2] - q[2]) * (p[0] + q[0]);
+            normal[2] += (p[0] - q[0]) * (p[1] + q[1]);
+        }
+        double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        double scale = length > 0.0 ? 1.0 / length : 0.0;
+        for (int axis = 0; axis < 3; axis++) {
+            sample.centroid[axis] = static_cast<float>(size > 0 ? centroid[axis] / size : 0.0);
+            sample.normal[axis] = static_cast<float>(normal[axis] * scale);
+        }
+        return true;
+    }
+
+private:
+    const double* points;
+    size_t pointStride;
+    size_t pointCount;
+};
+
+// Polygons given as control point indices plus polygon sizes (FbxMesh).
+inline bool SamplePolygons(const PolygonSampler& sampler, const int* indices, size_t indexCount,
+    const int* sizes, size_t polygonCount, std::vector<PolygonSample>& samples) {
+    samples.resize(polygonCount);
+    size_t start = 0;
+    for (size_t i = 0; i < polygonCount; i++) {
+        if (sizes[i] < 0 || indexCount - start < static_cast<size_t>(sizes[i])) return false;
+        if (!sampler.Sample(indices + start, sizes[i], samples[i])) return false;
+        start += static_cast<size_t>(sizes[i]);
+    }
+    return true;
+}
+
+// Polygons given as an FBX PolygonVertexIndex stream (last index of each
+// polygon stored as ~index).
+inline bool SampleFbxPolygons(const PolygonSampler& sampler, const int* indices, size_t count,
+    std::vector<PolygonSample>& samples) {
+    samples.clear();
+    std::vector<int> polygon;
+    for (size_t i = 0; i < count; i++) {
+        polygon.push_back(indices[i] < 0 ? ~indices[i] : indices[i]);
+        if (indices[i] >= 0) continue;
+        samples.emplace_back();
+        if (!sampler.Sample(polygon.data(), static_cast<int>(polygon.size()), samples.back())) return false;
+        polygon.clear();
+    }
+    return polygon.empty();
+}
+
+class PolygonGrid {
+public:
+    // source must outlive the grid. Samples whose centroid is not finite are
+    // left out.
+    void Build(const std::vector<PolygonSample>& source) {
+        samples = &source;
+        order.clear();
+        cellStart.clear();
+
+        std::vector<uint32_t> finite;
+        finite.reserve(source.size());
+        for (size_t i = 0; i < source.size(); i++) {
+            if (IsFinite(source[i].centroid)) finite.push_back(static_cast<uint32_t>(i));
+        }
+        if (finite.empty()) return;
+
+        float lo[3], hi[3];
+        for (int axis = 0; axis < 3; axis++) lo[axis] = hi[axis] = source[finite[0]].centroid[axis];
+        for (uint32_t i : finite) {
+            for (int axis = 0; axis < 3; axis++) {
+                lo[axis] = std::min(lo[axis], source[i].centroid[axis]);
+                hi[axis] = std::max(hi[axis], source[i].centroid[axis]);
+            }
+        }
+
+        // Neighbouring polygons are mostly stored next to each other, so the
+        // median step between consecutive centroids is a good spacing estimate.
+        std::vector<float> steps;
+        size_t stride = std::max<size_t>(1, finite.size() / 4096);
+        for (size_t i = 0; i + 1 < finite.size(); i += stride) {
+            float step = Distance2(source[finite[i]].centroid, source[finite[i + 1]].centroid);
+            if (step > 0.0f && std::isfinite(step)) steps.push_back(step);
+        }
+        cellSize = 0.0f;
+        if (!steps.empty()) {
+            std::nth_element(steps.begin(), steps.begin() + steps.size() / 2, steps.end());
+            cellSize = std::sqrt(steps[steps.size() / 2]);
+        }
+        float extent = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+        if (!(cellSize > 0.0f)) cellSize = extent > 0.0f ? extent : 1.0f;
+
+        // Grow the cells until the grid fits kCellsPerSample cells per sample;
+        // only surfaces that fill their bounding box badly need this. Extents
+        // that overflow float never fit: they get a single cell, searched in
+        // full.
+        double budget = static_cast<double>(finite.size()) * kCellsPerSample + 64.0;
+        bool fits = false;
+        for (int step = 0; step < kMaxGrowthSteps && !fits; step++) {
+            double cellCount = 1.0;
+            for (int axis = 0; axis < 3; axis++) {
+                cellCount *= std::floor(static_cast<double>(hi[axis] - lo[axis]) / cellSize) + 1.0;
+            }
+            fits = cellCount <= budget;
+            if (!fits) cellSize *= 1.25f;
+        }
+        for (int axis = 0; axis < 3; axis++) origin[axis] = lo[axis];
+        if (fits) {
+            inverseCellSize = 1.0f / cellSize;
+            for (int axis = 0; axis < 3; axis++) {
+                dims[axis] = static_cast<int64_t>((hi[axis] - lo[axis]) * inverseCellSize) + 1;
+            }
+        }
+        else {
+            cellSize = std::numeric_limits<float>::max();
+            inverseCellSize = 0.0f;
+            for (int axis = 0; axis < 3; axis++) dims[axis] = 1;
+        }
+
+        // Counting sort of the samples by cell.
+        std::vector<uint32_t> cellOf(finite.size());
+        cellStart.assign(static_cast<size_t>(dims[0] * dims[1] * dims[2]) + 1, 0);
+        for (size_t i = 0; i < finite.size(); i++) {
+            cellOf[i] = static_cast<uint32_t>(CellIndex(source[finite[i]].centroid));
+            cellStart[cellOf[i] + 1]++;
+        }
+        for (size_t cell = 1; cell < cellStart.size(); cell++) cellStart[cell] += cellStart[cell - 1];
+        order.resize(finite.size());
+        std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+        for (size_t i = 0; i < finite.size(); i++) order[fill[cellOf[i]]++] = finite[i];
+    }
+
+    // Index of the best source sample for sample, -1 if there are none.
+    int64_t Nearest(const PolygonSample& sample) const {
+        if (order.empty()) return -1;
+
+        // A NaN centroid is no distance from anything.
+        int64_t center[3];
+        if (!CellOf(sample.centroid, center)) return -1;
+        int64_t firstRing = 0, lastRing = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            int64_t outside = center[axis] < 0 ? -center[axis] : std::max<int64_t>(0, center[axis] - (dims[axis] - 1));
+            firstRing = std::max(firstRing, outside);
+            lastRing = std::max(lastRing, std::max(center[axis], dims[axis] - 1 - center[axis]));
+        }
+
+        Best aligned, any;
+        int64_t anyRing = -1;
+        if (firstRing > kRemapMaxRings) lastRing = -1;
+        lastRing = std::min(lastRing, firstRing + kRemapMaxRings);
+        for (int64_t ring = firstRing; ring <= lastRing; ring++) {
+            VisitRing(sample, center, ring, aligned, any);
+            // Anything not visited yet is at least ring * cellSize away.
+            float reach = static_cast<float>(ring) * cellSize;
+            if (aligned.index >= 0 && reach * reach >= aligned.distance2) break;
+            if (any.index >= 0 && anyRing < 0) anyRing = ring;
+            if (aligned.index < 0 && anyRing >= 0 && ring >= anyRing + 2) break;
+        }
+        if (any.index < 0) {
+            for (size_t i = 0; i < samples->size(); i++) Consider(sample, i, aligned, any);
+        }
+        return aligned.index >= 0 ? aligned.index : any.index;
+    }
+
+private:
+    struct Best {
+        int64_t index = -1;
+        float distance2 = std::numeric_limits<float>::max();
+    };
+
+    static const int kCellsPerSample = 8;
+    static const int kMaxGrowthSteps = 1024;  // 1.25^1024 exceeds any ratio of floats
+
+    static bool IsFinite(const float* point) {
+        return std::isfinite(point[0]) && std::isfinite(point[1]) && std::isfinite(point[2]);
+    }
+
+    static float Distance2(const float* a, const float* b) {
+        float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    // Unclamped cell coordinates; points far outside the grid saturate.
+    // Fails on a NaN coordinate, which has no cell.
+    bool CellOf(const float* point, int64_t cell[3]) const {
+        const float limit = 1e9f;
+        for (int axis = 0; axis < 3; axis++) {
+            float offset = (point[axis] - origin[axis]) * inverseCellSize;
+            if (std::isnan(offset)) {
+                // inf * 0 in a single-cell grid: any finite or infinite point lies in it.
+                if (inverseCellSize != 0.0f || std::isnan(point[axis])) return false;
+                offset = 0.0f;
+            }
+            offset = std::min(std::max(offset, -limit), limit);
+            cell[axis] = static_cast<int64_t>(std::floor(offset));
+        }
+        return true;
+    }
+
+    // Samples in the grid are finite, so they always have a cell.
+    int64_t CellIndex(const float* point) const {
+        int64_t cell[3];
+        CellOf(point, cell);
+        for (int axis = 0; axis < 3; axis++) cell[axis] = std::min(std::max<int64_t>(cell[axis], 0), dims[axis] - 1);
+        return (cell[0] * dims[1] + cell[1]) * dims[2] + cell[2];
+    }
+
+    void Consider(const PolygonSample& sample, size_t index, Best& aligned, Best& any) const {
+        const PolygonSample& candidate = (*samples)[index];
+        float distance2 = Distance2(sample.centroid, candidate.centroid);
+        if (distance2 < any.distance2) any = { static_cast<int64_t>(index), distance2 };
+        float dot = sample.normal[0] * candidate.normal[0] + sample.normal[1] * candidate.normal[1] +
+            sample.normal[2] * candidate.normal[2];
+        if (dot >= kRemapMinNormalDot && distance2 < aligned.distance2) aligned = { static_cast<int64_t>(index), distance2 };
+    }
+
+    // Samples of cells z0..z1 of one column, which are contiguous in order.
+    void VisitColumn(const PolygonSample& sample, int64_t x, int64_t y, int64_t z0, int64_t z1,
+        Best& aligned, Best& any) const {
+        size_t column = static_cast<size_t>((x * dims[1] + y) * dims[2]);
+        for (uint32_t i = cellStart[column + z0]; i < cellStart[column + z1 + 1]; i++) {
+            Consider(sample, order[i], aligned, any);
+        }
+    }
+
+    // Cells at Chebyshev distance ring from center, clipped to the grid.
+    void VisitRing(const PolygonSample& sample, const int64_t center[3], int64_t ring, Best& aligned, Best& any) const {
+        int64_t lo[3], hi[3];
+        for (int axis = 0; axis < 3; axis++) {
+            lo[axis] = std::max<int64_t>(center[axis] - ring, 0);
+            hi[axis] = std::min<int64_t>(center[axis] + ring, dims[axis] - 1);
+        }
+        if (lo[2] > hi[2]) return;
+        for (int64_t x = lo[0]; x <= hi[0]; x++) {
+            bool edgeX = x == center[0] - ring || x == center[0] + ring;
+            for (int64_t y = lo[1]; y <= hi[1]; y++) {
+                if (edgeX || y == center[1] - ring || y == center[1] + ring) {
+                    VisitColumn(sample, x, y, lo[2], hi[2], aligned, any);
+                    continue;
+                }
+                if (center[2] - ring == lo[2]) VisitColumn(sample, x, y, lo[2], lo[2], aligned, any);
+                if (center[2] + ring == hi[2] && ring > 0) VisitColumn(sample, x, y, hi[2], hi[2], aligned, any);
+            }
+        }
+    }
+
+    const std::vector<PolygonSample>* samples = nullptr;
+    std::vector<uint32_t> order;      // sample indices grouped by cell
+    std::vector<uint32_t> cellStart;  // order[cellStart[c]..cellStart[c + 1]) lie in cell c
+    float origin[3] = { 0.0f, 0.0f, 0.0f };
+    float cellSize = 1.0f;
+    float inverseCellSize = 1.0f;
+    int64_t dims[3] = { 1, 1, 1 };
+};
+
+// Index of the source sample each target polygon takes its island ID (and
+// any other per-polygon value) from, -1 if there is none (no source samples).
+inline void NearestPolygons(const std::vector<PolygonSample>& source, const std::vector<PolygonSample>& target,
+    std::vector<int64_t>& nearest) {
+    PolygonGrid grid;
+    grid.Build(source);
+    nearest.resize(target.size());
+    for (size_t i = 0; i < target.size(); i++) nearest[i] = grid.Nearest(target[i]);
+}
@@ -0,0 +1,151 @@
+﻿#define RIZOM_BRIDGE_BUILD
+#include "RizomBridge.h"
+#include "BridgeJobs.h"
+#include "SdkExtract.h"
+#include "SdkInject.h"
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Library state
+// ============================================================================
+//
+// Everything the tools' main()s set up once per process: the FBX SDK
+// manager, and the error message they would print.
+
+static std::mutex gBridgeMutex;
+static FbxManager* gBridgeManager = nullptr;
+static thread_local std::string gBridgeError;
+
+static FbxManager* BridgeManager() {
+    if (!gBridgeManager) {
+        ScopedPhase phase("sdk_init");
+        gBridgeManager = CreateBridgeManager();
+    }
+    return gBridgeManager;
+}
+
+// Same flags as the tool's command line, positional arguments excepted.
+template <typename Options, typename ParseToolFlag>
+static bool ParseBridgeOptions(const char* const* options, int optionCount, Options& parsed,
+    ParseToolFlag parseToolFlag, std::string& error) {
+    BridgeVerbosityLevel() = kVerbosityNormal;
+    std::string filterError;
+    for (int i = 0; i < optionCount; i++) {
+        if (!options[i]) {
+            error = "Option " + std::to_string(i) + " is null.";
+            return false;
+        }
+        if (ParseBridgeLogFlag(optionCount, options, i)) continue;
+        if (ParseNameFilterFlag(optionCount, options, i, parsed.filter, filterError)) continue;
+        if (parseToolFlag(optionCount, options, i, parsed)) continue;
+        error = std::string("Unknown option: ") + options[i];
+        return false;
+    }
+    if (!filterError.empty()) {
+        error = filterError;
+        return false;
+    }
+    return true;
+}
+
+// Runs call(error) under the library lock and turns its result, or anything
+// it throws, into a return code and gBridgeError. Nothing may unwind into
+// the C caller.
+template <typename Call>
+static int RunBridgeCall(Call call) {
+    gBridgeError.clear();
+    std::string error;
+    int result = 1;
+    try {
+        std::lock_guard<std::mutex> lock(gBridgeMutex);
+        result = call(error);
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+        result = 1;
+    }
+    catch (...) {
+        error = "Unknown error.";
+        result = 1;
+    }
+    if (result != 0) gBridgeError = error.empty() ? "Failed." : error;
+    return result;
+}
+
+// ============================================================================
+// C API
+// ============================================================================
+
+extern "C" {
+
+RIZOM_BRIDGE_API int rizom_bridge_api_version(void) {
+    return RIZOM_BRIDGE_API_VERSION;
+}
+
+RIZOM_BRIDGE_API int rizom_bridge_extract(const char* inputFbx, const char* const* options, int optionCount,
+    RizomBridgeBuffer* cache) {
+    return RunBridgeCall([&](std::string& error) {
+        if (!inputFbx || !cache) {
+            error = "inputFbx and cache are required.";
+            return 1;
+        }
+        *cache = RizomBridgeBuffer{};
+        ExtractOptions parsed;
+        if (!ParseBridgeOptions(options, optionCount, parsed, ParseExtractFlag, error)) return 1;
+
+        ScopedPhase phase("extraction");
+        std::unique_ptr<std::vector<char>> buffer(new std::vector<char>());
+        CacheWriter outFile;
+        outFile.OpenMemory(*buffer);
+        FbxManager* manager = parsed.native ? nullptr : BridgeManager();
+        if (ExtractToCache(manager, inputFbx, outFile, parsed, error) != 0) return 1;
+        if (!outFile.Close()) {
+            error = "Could not write the cache.";
+            return 1;
+        }
+        cache->data = buffer->data();
+        cache->size = buffer->size();
+        cache->handle = buffer.release();
+        return 0;
+    });
+}
+
+RIZOM_BRIDGE_API int rizom_bridge_inject(const char* targetFbx, const void* cache, size_t cacheSize,
+    const char* outputFbx, const char* const* options, int optionCount) {
+    return RunBridgeCall([&](std::string& error) {
+        if (!targetFbx || !cache || !outputFbx) {
+            error = "targetFbx, cache and outputFbx are required.";
+            return 1;
+        }
+        InjectOptions parsed;
+        if (!ParseBridgeOptions(options, optionCount, parsed, ParseInjectFlag, error)) return 1;
+
+        CacheSource source;
+        source.data = static_cast<const char*>(cache);
+        source.size = cacheSize;
+        return RunInjection(BridgeManager(), targetFbx, source, outputFbx, parsed, error);
+    });
+}
+
+RIZOM_BRIDGE_API void rizom_bridge_free(RizomBridgeBuffer* buffer) {
+    if (!buffer) return;
+    delete static_cast<std::vector<char>*>(buffer->handle);
+    *buffer = RizomBridgeBuffer{};
+}
+
+RIZOM_BRIDGE_API const char* rizom_bridge_last_error(void) {
+    return gBridgeError.c_str();
+}
+
+RIZOM_BRIDGE_API void rizom_bridge_shutdown(void) {
+    std::lock_guard<std::mutex> lock(gBridgeMutex);
+    if (gBridgeManager) gBridgeManager->Destroy();
+    gBridgeManager = nullptr;
+    PhaseTrace::Get().Write();
+}
+
+}
@@ -0,0 +1,76 @@
+﻿#pragma once
+#include <stddef.h>
+
+// ============================================================================
+// RizomUV Bridge library (C API)
+// ============================================================================
+//
+// The Extractor and the Injector as one shared library, so a host such as
+// the Blender addon (through ctypes) can run them in-process instead of
+// starting a tool, passing files and parsing its output. Caches go in and
+// out as memory buffers holding the usual .dat bytes (CacheFormat.h).
+//
+// options are the tools' own flags, one argument per entry, e.g.
+// { "--threads", "0", "--include", "=Cube" }: --quiet, --verbose, --trace,
+// --include, --exclude, --filter-file, and those of the tool (--compact-ids,
+// --remap-data, --native for extraction; --patch, --ignore-topology for
+// injection; --threads for both). They apply to that call only, except
+// --trace, which is written by rizom_bridge_shutdown.
+//
+// Every call returns 0 on success and non-zero on failure, with a message
+// for rizom_bridge_last_error on the calling thread. The FBX SDK manager is
+// created on first use and kept until rizom_bridge_shutdown. Calls may come
+// from any thread; they run one at a time.
+//
+// Build RizomBridge.cpp as a shared library against the FBX SDK, e.g.
+//   cl /std:c++17 /O2 /LD RizomBridge.cpp libfbxsdk.lib /Fe:rizombridge.dll
+
+#define RIZOM_BRIDGE_API_VERSION 1
+
+#if defined(_WIN32)
+#if defined(RIZOM_BRIDGE_BUILD)
+#define RIZOM_BRIDGE_API __declspec(dllexport)
+#else
+#define RIZOM_BRIDGE_API __declspec(dllimport)
+#endif
+#else
+#define RIZOM_BRIDGE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A cache produced by the library, released with rizom_bridge_free.
+typedef struct RizomBridgeBuffer {
+    const char* data;
+    size_t size;
+    void* handle;  // owned by the library
+} RizomBridgeBuffer;
+
+// RIZOM_BRIDGE_API_VERSION of the library, for callers that load it at run
+// time and cannot check the header.
+RIZOM_BRIDGE_API int rizom_bridge_api_version(void);
+
+// Extracts the RizomUV data of inputFbx into cache.
+RIZOM_BRIDGE_API int rizom_bridge_extract(const char* inputFbx, const char* const* options, int optionCount,
+    RizomBridgeBuffer* cache);
+
+// Injects cacheSize bytes of cache (from rizom_bridge_extract, or a .dat
+// file read by the caller) into targetFbx and writes outputFbx. cache is
+// only read during the call.
+RIZOM_BRIDGE_API int rizom_bridge_inject(const char* targetFbx, const void* cache, size_t cacheSize,
+    const char* outputFbx, const char* const* options, int optionCount);
+
+RIZOM_BRIDGE_API void rizom_bridge_free(RizomBridgeBuffer* buffer);
+
+// Why the last failed call on this thread failed; empty after a success.
+RIZOM_BRIDGE_API const char* rizom_bridge_last_error(void);
+
+// Destroys the FBX SDK manager and writes the --trace, if one was asked
+// for. Later calls start a new manager.
+RIZOM_BRIDGE_API void rizom_bridge_shutdown(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,225 @@
+﻿#pragma once
+#include <fbxsdk.h>
+#include "ExtractRecords.h"
+#include "NativeExtract.h"
+#include "SdkPropertyType.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// SDK extraction
+// ============================================================================
+//
+// Reads the RizomUV properties and user data of an imported scene into a
+// cache. Shared by the Extractor and the bridge library (RizomBridge.h).
+
+// ============================================================================
+// SDK SNAPSHOTS
+// ============================================================================
+
+inline PropertySnapshot SnapshotProperty(const FbxProperty& prop) {
+    PropertySnapshot snap;
+    snap.propName = prop.GetName().Buffer();
+    snap.typeName = prop.GetPropertyDataType().GetName();
+    snap.type = SdkPropertyType(prop.GetPropertyDataType());
+    GetSdkValue(prop, snap.type, snap.bytes);
+    return snap;
+}
+
+// ============================================================================
+// EXTRACTION from FbxDocument
+// ============================================================================
+
+inline void ExtractDocumentRizomData(FbxScene* scene, CacheWriter& outFile) {
+    BRIDGE_LOG("\n=== Extracting RizomUV data from FbxDocument ===");
+    ScopedPhase phase("extract_document");
+    FbxDocument* rootDocument = scene->GetRootDocument();
+    if (!rootDocument) return;
+
+    std::vector<PropertySnapshot> properties;
+    FbxProperty rizomProp = rootDocument->FindProperty("RizomUV");
+    if (rizomProp.IsValid()) {
+        properties.push_back(SnapshotProperty(rizomProp));
+
+        FbxProperty sceneProp = rizomProp.Find("Scene");
+        if (sceneProp.IsValid()) {
+            properties.push_back(SnapshotProperty(sceneProp));
+        }
+
+        FbxProperty uvSetsProp = rizomProp.Find("UVSets");
+        if (uvSetsProp.IsValid()) {
+            properties.push_back(SnapshotProperty(uvSetsProp));
+
+            FbxProperty uvMapProp = uvSetsProp.Find("UVMap");
+            if (uvMapProp.IsValid()) {
+                properties.push_back(SnapshotProperty(uvMapProp));
+
+                FbxProperty rootGroupProp = uvMapProp.Find("RootGroup");
+                if (rootGroupProp.IsValid()) {
+                    properties.push_back(SnapshotProperty(rootGroupProp));
+                }
+            }
+        }
+    }
+    WriteDocumentBlock(outFile, properties);
+}
+
+// ============================================================================
+// EXTRACTION FROM GEOMETRY
+// ============================================================================
+
+// SDK reads happen in one serial pass; classification and record encoding
+// run on options.threadCount threads. Records are written in node order, so the
+// output is identical for every thread count.
+inline void ExtractGeometryRizomData(FbxScene* scene, CacheWriter& outFile, const ExtractOptions& options) {
+    BRIDGE_LOG("\n=== Extracting RizomUV data from Geometries ===");
+    ScopedPhase phase("extract_geometry");
+
+    std::vector<MeshSnapshot> meshes;
+    std::vector<std::pair<FbxLayerElementArrayTemplate<void*>*, void*>> locks;
+    size_t filtered = 0;
+    ScopedPhase snapshotPhase("snapshot_meshes");
+    int nodeCount = scene->GetNodeCount();
+    for (int i = 0; i < nodeCount; i++) {
+        FbxNode* node = scene->GetNode(i);
+        FbxNodeAttribute* attr = node->GetNodeAttribute();
+
+        if (attr && attr->GetAttributeType() == FbxNodeAttribute::eMesh) {
+            FbxMesh* mesh = node->GetMesh();
+            if (!options.filter.Selects(node->GetName(), mesh->GetName())) {
+                ++filtered;
+                continue;
+            }
+
+            meshes.emplace_back();
+            MeshSnapshot& snap = meshes.back();
+            snap.nodeName = node->GetName();
+            snap.meshName = mesh->GetName();
+
+            FbxProperty rizomProp = mesh->FindProperty("RizomUV");
+            if (rizomProp.IsValid()) {
+                snap.properties.push_back(SnapshotProperty(rizomProp));
+            }
+
+            FbxProperty uvSetsProp = mesh->FindProperty("RizomUVUVSets");
+            if (uvSetsProp.IsValid()) {
+                snap.properties.push_back(SnapshotProperty(uvSetsProp));
+            }
+
+            int layerCount = mesh->GetLayerCount();
+            for (int layerIndex = 0; layerIndex < layerCount; layerIndex++) {
+                FbxLayer* layer = mesh->GetLayer(layerIndex);
+                FbxLayerElementUserData* userData = layer->GetUserData();
+                if (!userData) continue;
+
+                snap.userData.emplace_back();
+                UserDataSnapshot& userDataSnap = snap.userData.back();
+                userDataSnap.name = userData->GetName();
+                userDataSnap.layer = static_cast<uint32_t>(layerIndex);
+                userDataSnap.mapping = static_cast<uint8_t>(userData->GetMappingMode());
+                userDataSnap.reference = static_cast<uint8_t>(userData->GetReferenceMode());
+                if (!IsRizomUserData(userDataSnap.name)) continue;
+
+                // Locked, not copied: the encode threads read the SDK arrays directly.
+                int arrayCount = userData->GetDirectArrayCount();
+                for (int arrayIndex = 0; arrayIndex < arrayCount; arrayIndex++) {
+                    userDataSnap.arrays.emplace_back();
+                    UserDataArraySnapshot& arraySnap = userDataSnap.arrays.back();
+                    FbxDataType dataType = userData->GetDataType(arrayIndex);
+                    arraySnap.name = userData->GetDataName(arrayIndex);
+                    arraySnap.typeName = dataType.GetName();
+                    arraySnap.type = SdkPropertyType(dataType);
+                    if (!IsUserDataType(arraySnap.type)) continue;
+
+                    bool getStatus = false;
+                    FbxLayerElementArrayTemplate<void*>* voidArray = userData->GetDirectArrayVoid(arrayIndex, &getStatus);
+                    if (getStatus && voidArray) {
+                        void* locked = voidArray->GetLocked(FbxLayerElementArray::eReadLock);
+                        arraySnap.count = voidArray->GetCount();
+                        arraySnap.data = locked;
+                        if (locked) locks.push_back({ voidArray, locked });
+                    }
+                }
+            }
+
+            if (!CarriesRizomData(snap)) continue;
+
+            // Polygon sizes are counted here; the index stream is hashed on the
+            // encode threads and stays valid until the scene is destroyed.
+            snap.topology = FingerprintMesh(mesh, false);
+            snap.polygonVertices = mesh->GetPolygonVertices();
+            snap.hasTopology = true;
+
+            // Sampled on the encode threads too; FbxVector4 is four doubles.
+            if (options.remapData && snap.polygonVertices && HasRizomUserData(snap)) {
+                int polygonCount = mesh->GetPolygonCount();
+                snap.polygonSizes.resize(polygonCount);
+                for (int p = 0; p < polygonCount; p++) snap.polygonSizes[p] = mesh->GetPolygonSize(p);
+                snap.points = reinterpret_cast<const double*>(mesh->GetControlPoints());
+                snap.pointStride = 4;
+                snap.pointCount = static_cast<size_t>(mesh->GetControlPointsCount());
+            }
+        }
+    }
+
+    snapshotPhase.Count("meshes", meshes.size());
+    snapshotPhase.Count("filtered", filtered);
+    snapshotPhase.Stop();
+
+    WriteMeshBlocks(outFile, meshes, options.threadCount, options.compactIds);
+
+    for (auto& lock : locks) {
+        lock.first->Release(&lock.second);
+    }
+}
+
+// ============================================================================
+// JOB
+// ============================================================================
+
+// Writes the cache of inputFBX into outFile, opened by the caller and closed
+// on success. The native backend does not use manager.
+inline int ExtractToCache(FbxManager* manager, const char* inputFBX, CacheWriter& outFile,
+    const ExtractOptions& options, std::string& error) {
+    if (options.native) {
+        return ExtractNativeToCache(inputFBX, outFile, options, error);
+    }
+
+    FbxImporter* importer = FbxImporter::Create(manager, "");
+    if (!importer->Initialize(inputFBX, -1, manager->GetIOSettings())) {
+        error = std::string("Could not open FBX file: ") + importer->GetStatus().GetErrorString();
+        importer->Destroy();
+        return 1;
+    }
+
+    FbxScene* scene = FbxScene::Create(manager, "Scene");
+    {
+        ScopedPhase phase("import");
+        importer->Import(scene);
+        importer->Destroy();
+    }
+
+    ExtractDocumentRizomData(scene, outFile);
+    ExtractGeometryRizomData(scene, outFile, options);
+    scene->Destroy();
+    return 0;
+}
+
+inline int RunExtraction(FbxManager* manager, const char* inputFBX, const char* outputDAT,
+    const ExtractOptions& options, std::string& error) {
+    ScopedPhase phase("extraction");
+    CacheWriter outFile;
+    if (!outFile.Open(outputDAT)) {
+        error = std::string("Could not open output file: ") + outputDAT;
+        return 1;
+    }
+    if (ExtractToCache(manager, inputFBX, outFile, options, error) != 0) return 1;
+
+    ScopedPhase closePhase("cache_close");
+    if (!outFile.Close()) {
+        error = std::string("Could not write output file: ") + outputDAT;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,411 @@
+﻿#pragma once
+#include <fbxsdk.h>
+#include "CacheReader.h"
+#include "FbxPatch.h"
+#include "ParallelFor.h"
+#include "Remap.h"
+#include "SdkPropertyType.h"
+#include "Topology.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// SDK injection
+// ============================================================================
+//
+// Writes a loaded cache into an imported scene and exports it, or patches
+// the binary FBX directly (FbxPatch.h). Shared by the Injector and the
+// bridge library (RizomBridge.h).
+
+// ============================================================================
+// Inject FbxDocument
+// ============================================================================
+
+// Creates name under parent with the type it was cached with and sets the
+// cached value. Without a cached value it is created as defaultType, so the
+// properties below it still have a parent.
+template <typename Parent>
+inline FbxProperty CreateCachedProperty(Parent parent, const PropertyMap& properties, const char* name,
+    PropertyType defaultType, const char* label) {
+    const CacheProperty* cached = FindProperty(properties, name);
+    FbxProperty prop = FbxProperty::Create(parent, SdkDataType(cached ? cached->type : defaultType), name);
+    if (prop.IsValid() && cached) {
+        if (SetSdkValue(prop, cached->type, cached->value)) {
+            BRIDGE_LOG_ITEM("  Created: " << label << " (" << GetPropertyTypeInfo(cached->type).name
+                << ", " << cached->value.size << " bytes)");
+        }
+        else {
+            std::cerr << "Warning: Cached value of " << label << " does not fit its type." << std::endl;
+        }
+    }
+    return prop;
+}
+
+inline void InjectDocumentRizomData(FbxScene* scene, PropertyMap& properties) {
+
+    BRIDGE_LOG("\n=== Injecting RizomUV data into FbxDocument ===");
+    ScopedPhase phase("inject_document");
+
+    FbxDocument* rootDocument = scene->GetRootDocument();
+    if (!rootDocument) return;
+
+    rootDocument->SetName("Scene");
+
+    FbxProperty rizomProp = CreateCachedProperty(rootDocument, properties, "RizomUV", kPropertyInt,
+        "RizomUV");
+    CreateCachedProperty(rizomProp, properties, "Scene", kPropertyBlob, "RizomUV->Scene");
+    FbxProperty uvSetsProp = CreateCachedProperty(rizomProp, properties, "UVSets", kPropertyString,
+        "RizomUV->UVSets");
+    FbxProperty uvMapProp = CreateCachedProperty(uvSetsProp, properties, "UVMap", kPropertyString,
+        "RizomUV->UVSets->UVMap");
+    CreateCachedProperty(uvMapProp, properties, "RootGroup", kPropertyBlob,
+        "RizomUV->UVSets->UVMap->RootGroup");
+
+    BRIDGE_LOG("  SUCCESS: Document property hierarchy created.");
+}
+
+// ============================================================================
+// Inject Geometry
+// ============================================================================
+
+// Creates the user data element of geoData.userData[first, last) on its
+// layer and copies each array into it in one piece. remapped, when given,
+// replaces the cached values (one per polygon of the edited mesh).
+inline void InjectUserDataElement(FbxMesh* mesh, const GeometryData& geoData, size_t first, size_t last,
+    const RemappedUserData* remapped) {
+    const UserDataArray& element = geoData.userData[first];
+    size_t valueCount = remapped ? (*remapped)[first].size() / PropertyValueSize(element.type) : element.values.count;
+    if (valueCount == 0) return;
+
+    while (mesh->GetLayerCount() <= static_cast<int>(element.layer)) mesh->CreateLayer();
+    FbxLayer* layer = mesh->GetLayer(static_cast<int>(element.layer));
+
+    std::string userDataName = element.elementName.size == 0 ? "RizomUVUVMapIslandGroupIDs" :
+        std::string(element.elementName.data, element.elementName.size);
+    BRIDGE_LOG_ITEM("  Creating UserData: '" << userDataName << "' on layer " << element.layer);
+
+    std::vector<std::string> names;
+    FbxArray<FbxDataType> dataTypes;
+    FbxArray<const char*> dataNames;
+    for (size_t a = first; a < last; a++) {
+        names.emplace_back(geoData.userData[a].arrayName.data, geoData.userData[a].arrayName.size);
+        dataTypes.Add(SdkDataType(geoData.userData[a].type));
+    }
+    for (const std::string& name : names) dataNames.Add(name.c_str());
+
+    FbxLayerElementUserData* userData = FbxLayerElementUserData::Create(
+        mesh,
+        userDataName.c_str(),
+        static_cast<int>(element.layer),
+        dataTypes,
+        dataNames
+    );
+    if (!userData) return;
+
+    userData->SetMappingMode(static_cast<FbxLayerElement::EMappingMode>(element.mapping));
+    userData->SetReferenceMode(static_cast<FbxLayerElement::EReferenceMode>(element.reference));
+    userData->ResizeAllDirectArrays(static_cast<int>(valueCount));
+
+    for (size_t a = first; a < last; a++) {
+        const UserDataArray& array = geoData.userData[a];
+        size_t count = remapped ? (*remapped)[a].size() / PropertyValueSize(array.type) : array.values.count;
+        if (count != valueCount) {
+            std::cerr << "Warning: User data array '" << names[a - first] << "' of '" << userDataName
+                << "' does not match the length of its element, skipped\n";
+            continue;
+        }
+
+        bool getStatus = false;
+        FbxLayerElementArrayTemplate<void*>* voidArray = userData->GetDirectArrayVoid(static_cast<int>(a - first), &getStatus);
+        if (!getStatus || !voidArray) continue;
+        void* dataPtr = voidArray->GetLocked(FbxLayerElementArray::eWriteLock);
+        if (!dataPtr) continue;
+        if (remapped) {
+            std::memcpy(dataPtr, (*remapped)[a].data(), (*remapped)[a].size());
+        }
+        else {
+            CopyUserDataValues(array, dataPtr);
+        }
+        voidArray->Release(&dataPtr);
+        BRIDGE_LOG_ITEM("  SAVED " << count << " " << GetPropertyTypeInfo(array.type).name << " values ('"
+            << names[a - first] << "')");
+    }
+
+    layer->SetUserData(userData);
+}
+
+// remapped, when given, replaces the cached user data (RemapUserData).
+inline void InjectMeshRizomData(FbxMesh* mesh, const GeometryData& geoData, const RemappedUserData* remapped) {
+    // ===  1:  RizomUV Properties ===
+    for (const char* propName : { "RizomUV", "RizomUVUVSets" }) {
+        if (FindProperty(geoData.properties, propName)) {
+            CreateCachedProperty(mesh, geoData.properties, propName, kPropertyNone, propName);
+        }
+    }
+
+    // === 2: User data, one element per layer ===
+    for (size_t first = 0; first < geoData.userData.size();) {
+        size_t last = UserDataElementEnd(geoData.userData, first);
+        InjectUserDataElement(mesh, geoData, first, last, remapped);
+        first = last;
+    }
+}
+
+// The arrays SampleMesh reads, taken on the main thread like the
+// extractor's snapshots: FbxMesh getters are not documented as thread-safe,
+// the arrays they return stay valid until the scene is destroyed.
+struct MeshPolygons {
+    std::vector<int> sizes;
+    const int* polygonVertices = nullptr;
+    size_t polygonVertexCount = 0;
+    const double* points = nullptr;  // FbxVector4, four doubles each
+    size_t pointCount = 0;
+};
+
+inline void SnapshotMeshPolygons(FbxMesh* mesh, MeshPolygons& polygons) {
+    int polygonCount = mesh->GetPolygonCount();
+    polygons.sizes.resize(polygonCount);
+    for (int p = 0; p < polygonCount; p++) polygons.sizes[p] = mesh->GetPolygonSize(p);
+    polygons.polygonVertices = mesh->GetPolygonVertices();
+    polygons.polygonVertexCount = static_cast<size_t>(mesh->GetPolygonVertexCount());
+    polygons.points = mesh->GetControlPoints() ? &mesh->GetControlPoints()[0][0] : nullptr;
+    polygons.pointCount = static_cast<size_t>(mesh->GetControlPointsCount());
+}
+
+// Polygon samples of a mesh (Remap.h), matching those the extractor stores.
+// Touches no SDK object, so meshes can be sampled concurrently.
+inline bool SampleMesh(const MeshPolygons& polygons, std::vector<PolygonSample>& samples) {
+    PolygonSampler sampler(polygons.points, 4, polygons.pointCount);
+    return SamplePolygons(sampler, polygons.polygonVertices, polygons.polygonVertexCount,
+        polygons.sizes.data(), polygons.sizes.size(), samples);
+}
+
+// Data already on a mesh, from an earlier injection, is replaced: the cache
+// is the newer extraction and the document groups are replaced too, so old
+// island IDs would no longer match them. With checkTopology,
+// meshes whose polygons no longer match the fingerprint taken at extraction
+// get their island IDs remapped when the cache has polygon samples
+// (Extractor --remap-data), across options.threadCount threads; without
+// samples they are skipped and reported, since their IDs would be wrong.
+inline void InjectGeometryRizomData(FbxScene* scene, GeometryTable& geometryData, const InjectOptions& options) {
+    BRIDGE_LOG("\n=== Injecting RizomUV data into Geometries ===");
+    ScopedPhase phase("inject_geometry");
+    size_t injected = 0, replaced = 0, mismatched = 0, remapped = 0, filtered = 0;
+
+    struct MeshTarget {
+        FbxMesh* mesh;
+        const GeometryData* geoData;
+        const char* lookupName;
+        bool remap;
+        bool replace;
+        MeshPolygons polygons;
+        RemappedUserData remapped;
+    };
+    std::vector<MeshTarget> targets;
+
+    int nodeCount = scene->GetNodeCount();
+    for (int i = 0; i < nodeCount; i++) {
+        FbxNode* node = scene->GetNode(i);
+        FbxNodeAttribute* attr = node->GetNodeAttribute();
+
+        if (attr && attr->GetAttributeType() == FbxNodeAttribute::eMesh) {
+            FbxMesh* mesh = node->GetMesh();
+
+            const char* nodeName = node->GetName();
+            const char* meshName = mesh->GetName();
+            if (!options.filter.Selects(nodeName, meshName)) {
+                ++filtered;
+                continue;
+            }
+
+            BRIDGE_LOG_ITEM("\nChecking node: " << nodeName << " (mesh: " << meshName << ")");
+
+            const char* lookupName = nullptr;
+            GeometryData* geoData = nullptr;
+
+            if ((geoData = geometryData.Find(nodeName, std::strlen(nodeName)))) {
+                lookupName = nodeName;
+                BRIDGE_LOG_ITEM("  OK Found data for NODE name: " << nodeName);
+            }
+            else if ((geoData = geometryData.Find(meshName, std::strlen(meshName)))) {
+                lookupName = meshName;
+                BRIDGE_LOG_ITEM("  OK Found data for MESH name: " << meshName);
+            }
+            else {
+                BRIDGE_LOG_ITEM("  -- No data found for '" << nodeName << "' or '" << meshName << "'");
+                continue;
+            }
+            if (geoData->Empty()) {
+                BRIDGE_LOG_ITEM("  -- No RizomUV data cached for '" << lookupName << "'");
+                continue;
+            }
+
+            // FbxProperty::Create returns an existing property and FbxLayer::SetUserData
+            // replaces the layer's element, so injecting overwrites older data.
+            bool replace = mesh->FindProperty("RizomUV").IsValid() || mesh->FindProperty("RizomUVUVSets").IsValid();
+            if (replace) BRIDGE_LOG_ITEM("  '" << lookupName << "' already has RizomUV data, replacing it");
+
+            bool remap = false;
+            if (options.checkTopology && geoData->hasTopology) {
+                TopologyFingerprint current = FingerprintMesh(mesh);
+                if (current != geoData->topology) {
+                    std::string change = DescribeTopologyChange(geoData->topology, current);
+                    if (!CanRemapUserData(*geoData)) {
+                        std::cerr << "Warning: '" << lookupName << "' changed since extraction ("
+                            << change << "), RizomUV data skipped\n";
+                        ++mismatched;
+                        continue;
+                    }
+                    BRIDGE_LOG_ITEM("  '" << lookupName << "' changed since extraction (" << change << "), remapping");
+                    remap = true;
+                }
+            }
+            targets.push_back(MeshTarget{ mesh, geoData, lookupName, remap, replace, MeshPolygons(), RemappedUserData() });
+            if (remap) SnapshotMeshPolygons(mesh, targets.back().polygons);
+        }
+    }
+
+    std::vector<char> remapFailed(targets.size(), 0);
+    {
+        ScopedPhase remapPhase("remap");
+        ParallelFor(targets.size(), options.threadCount, [&](size_t i) {
+            MeshTarget& target = targets[i];
+            if (!target.remap) return;
+            std::vector<PolygonSample> samples;
+            remapFailed[i] = !SampleMesh(target.polygons, samples) ||
+                !RemapUserData(*target.geoData, samples, target.remapped);
+        });
+    }
+
+    for (size_t i = 0; i < targets.size(); i++) {
+        MeshTarget& target = targets[i];
+        if (remapFailed[i]) {
+            std::cerr << "Warning: '" << target.lookupName
+                << "' could not be remapped onto its edited polygons, RizomUV data skipped\n";
+            ++mismatched;
+            continue;
+        }
+
+        ScopedPhase meshPhase("inject_mesh", target.lookupName);
+        BRIDGE_LOG_ITEM("Processing geometry: " << target.lookupName);
+        meshPhase.Count("arrays", target.geoData->userData.size());
+        InjectMeshRizomData(target.mesh, *target.geoData, target.remap ? &target.remapped : nullptr);
+        ++injected;
+        if (target.remap) ++remapped;
+        if (target.replace) ++replaced;
+    }
+    phase.Count("meshes", injected);
+    phase.Count("remapped", remapped);
+    phase.Count("mismatched", mismatched);
+    phase.Count("filtered", filtered);
+    BRIDGE_LOG("\n  SUCCESS: Geometry data injected into " << injected << " meshes (" << remapped << " remapped, "
+        << replaced << " replaced older data, " << mismatched << " topology mismatches, " << filtered << " filtered out).");
+}
+
+
+// ============================================================================
+// Job
+// ============================================================================
+
+inline int RunInjection(FbxManager* manager, const char* targetFBX, const CacheSource& source,
+    const char* outputFBX, const InjectOptions& options, std::string& error) {
+    ScopedPhase phase("injection");
+
+    // The cache does not depend on the scene: read it while the target is
+    // parsed or imported.
+    PendingCache pending;
+    pending.Start(source, options.filter);
+
+    if (options.patchInPlace) {
+        std::string reason;
+        bool cacheFailed = false;
+        if (PatchBinaryFbx(targetFBX, pending, outputFBX, options, reason, cacheFailed)) {
+            BRIDGE_LOG("PATCH OK: Binary FBX patched in place");
+            return 0;
+        }
+        if (cacheFailed) {
+            error = "Could not load cache " + CacheSourceName(source) + ": " + pending.Error();
+            return 1;
+        }
+        BRIDGE_LOG("  Cannot patch in place (" << reason << "), using the FBX SDK.");
+    }
+
+    FbxImporter* importer = FbxImporter::Create(manager, "");
+    if (!importer->Initialize(targetFBX, -1, manager->GetIOSettings())) {
+        error = "Could not open the target FBX file.";
+        importer->Destroy();
+        return 1;
+    }
+
+    FbxScene* scene = FbxScene::Create(manager, "Scene");
+    auto importStart = std::chrono::steady_clock::now();
+    {
+        ScopedPhase phase("import");
+        importer->Import(scene);
+        importer->Destroy();
+    }
+    double importMs = ElapsedMs(importStart);
+
+    std::set<std::string> sceneMeshNames;
+    for (int i = 0; i < scene->GetNodeCount(); i++) {
+        FbxNode* node = scene->GetNode(i);
+        FbxNodeAttribute* attr = node->GetNodeAttribute();
+        if (attr && attr->GetAttributeType() == FbxNodeAttribute::eMesh &&
+            options.filter.Selects(node->GetName(), node->GetMesh()->GetName())) {
+            sceneMeshNames.insert(node->GetName());
+            sceneMeshNames.insert(node->GetMesh()->GetName());
+        }
+    }
+
+    LoadedCache* cache = pending.Wait(&sceneMeshNames);
+    if (!cache) {
+        error = "Could not load cache " + CacheSourceName(source) + ": " + pending.Error();
+        scene->Destroy();
+        return 1;
+    }
+    auto injectStart = std::chrono::steady_clock::now();
+    InjectDocumentRizomData(scene, cache->documentProperties);
+    InjectGeometryRizomData(scene, cache->geometryData, options);
+    double injectMs = ElapsedMs(injectStart);
+
+    BRIDGE_LOG("\n=== CONVERTING: ASCII -> BINARY ===");
+    BRIDGE_LOG("Saving to: " << outputFBX);
+    auto exportStart = std::chrono::steady_clock::now();
+    ScopedPhase exportPhase("export");
+
+    FbxExporter* exporter = FbxExporter::Create(manager, "");
+
+    int fileFormat = manager->GetIOPluginRegistry()->FindWriterIDByDescription("FBX binary (*.fbx)");
+
+    if (fileFormat == -1) {
+        std::cerr << "ERROR: FBX binary format not found! Falling back to ASCII." << std::endl;
+        fileFormat = manager->GetIOPluginRegistry()->FindWriterIDByDescription("FBX ascii (*.fbx)");
+    }
+
+    if (!exporter->Initialize(outputFBX, fileFormat, manager->GetIOSettings())) {
+        error = "Error during exporter initialization.";
+        exporter->Destroy();
+        scene->Destroy();
+        return 1;
+    }
+
+    bool exported = exporter->Export(scene);
+    if (exported) {
+        BRIDGE_LOG("EXPORT OK: Binary FBX created successfully");
+    }
+    else {
+        error = "ERROR: Export failed!";
+    }
+
+    exporter->Destroy();
+    scene->Destroy();
+    exportPhase.Stop();
+    BRIDGE_LOG("Stages: import " << importMs << " ms, cache load " << pending.LoadMs()
+        << " ms (overlapped, waited " << pending.WaitMs() << " ms, finished in " << pending.FinishMs()
+        << " ms), inject " << injectMs << " ms, export " << ElapsedMs(exportStart) << " ms");
+    return exported ? 0 : 1;
+}
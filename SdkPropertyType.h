@@ -0,0 +1,107 @@
+﻿#pragma once
+#include <fbxsdk.h>
+#include "MappedFile.h"
+#include "PropertyType.h"
+#include <string>
+
+// ============================================================================
+// Property types on the FBX SDK side
+// ============================================================================
+//
+// The FbxDataType behind each PropertyType tag, and how the two SDK tools
+// move values between an FbxProperty and the cache layout.
+
+// Indexed by PropertyType; kPropertyNone maps to FbxUndefinedDT.
+inline const FbxDataType& SdkDataType(PropertyType type) {
+    static const FbxDataType* const kDataTypes[kPropertyTypeCount] = {
+        &FbxUndefinedDT, &FbxBoolDT, &FbxIntDT, &FbxEnumDT, &FbxULongLongDT, &FbxTimeDT, &FbxFloatDT,
+        &FbxDoubleDT, &FbxDouble3DT, &FbxDouble4DT, &FbxColor3DT, &FbxColor4DT, &FbxStringDT, &FbxUrlDT,
+        &FbxBlobDT,
+    };
+    return *kDataTypes[IsPropertyType(type) ? type : kPropertyNone];
+}
+
+// Exact matches first, so a colour or URL keeps its type instead of being
+// taken for the vector or string it specialises.
+inline PropertyType SdkPropertyType(const FbxDataType& dataType) {
+    for (uint8_t tag = 1; tag < kPropertyTypeCount; tag++) {
+        if (dataType == SdkDataType(static_cast<PropertyType>(tag))) return static_cast<PropertyType>(tag);
+    }
+    for (uint8_t tag = 1; tag < kPropertyTypeCount; tag++) {
+        if (dataType.Is(SdkDataType(static_cast<PropertyType>(tag)))) return static_cast<PropertyType>(tag);
+    }
+    return kPropertyNone;
+}
+
+// Appends the value of prop, read as type, in the cache layout.
+inline void GetSdkValue(const FbxProperty& prop, PropertyType type, std::string& bytes) {
+    switch (type) {
+    case kPropertyBool: AppendPropertyElement(bytes, type, prop.Get<FbxBool>(), 0.0, false); break;
+    case kPropertyInt: AppendPropertyElement(bytes, type, prop.Get<FbxInt>(), 0.0, false); break;
+    case kPropertyEnum: AppendPropertyElement(bytes, type, prop.Get<FbxEnum>(), 0.0, false); break;
+    case kPropertyULongLong:
+        AppendPropertyElement(bytes, type, static_cast<int64_t>(prop.Get<FbxULongLong>()), 0.0, false);
+        break;
+    case kPropertyTime: AppendPropertyElement(bytes, type, prop.Get<FbxTime>().Get(), 0.0, false); break;
+    case kPropertyFloat: AppendPropertyElement(bytes, type, 0, prop.Get<FbxFloat>(), true); break;
+    case kPropertyDouble: AppendPropertyElement(bytes, type, 0, prop.Get<FbxDouble>(), true); break;
+    case kPropertyVector3:
+    case kPropertyColor3: {
+        FbxDouble3 value = prop.Get<FbxDouble3>();
+        for (int i = 0; i < 3; i++) AppendPropertyElement(bytes, type, 0, value[i], true);
+        break;
+    }
+    case kPropertyVector4:
+    case kPropertyColor4: {
+        FbxDouble4 value = prop.Get<FbxDouble4>();
+        for (int i = 0; i < 4; i++) AppendPropertyElement(bytes, type, 0, value[i], true);
+        break;
+    }
+    case kPropertyString:
+    case kPropertyUrl:
+        bytes += prop.Get<FbxString>().Buffer();
+        break;
+    case kPropertyBlob: {
+        FbxBlob blob = prop.Get<FbxBlob>();
+        if (blob.Size() > 0) bytes.append(static_cast<const char*>(blob.Access()), blob.Size());
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Sets prop from a cached value of type; false if the value does not fit it.
+inline bool SetSdkValue(FbxProperty& prop, PropertyType type, const ByteSpan& value) {
+    size_t size = PropertyValueSize(type);
+    if (size != 0 && value.size != size) return false;
+    const char* data = value.data;
+    switch (type) {
+    case kPropertyBool: return prop.Set(FbxBool(ReadIntegerElement(type, data, 0) != 0));
+    case kPropertyInt: return prop.Set(FbxInt(ReadIntegerElement(type, data, 0)));
+    case kPropertyEnum: return prop.Set(FbxEnum(ReadIntegerElement(type, data, 0)));
+    case kPropertyULongLong: return prop.Set(FbxULongLong(ReadIntegerElement(type, data, 0)));
+    case kPropertyTime: {
+        FbxTime time;
+        time.Set(ReadIntegerElement(type, data, 0));
+        return prop.Set(time);
+    }
+    case kPropertyFloat: return prop.Set(FbxFloat(ReadRealElement(type, data, 0)));
+    case kPropertyDouble: return prop.Set(FbxDouble(ReadRealElement(type, data, 0)));
+    case kPropertyVector3:
+    case kPropertyColor3:
+        return prop.Set(FbxDouble3(ReadRealElement(type, data, 0), ReadRealElement(type, data, 1),
+            ReadRealElement(type, data, 2)));
+    case kPropertyVector4:
+    case kPropertyColor4:
+        return prop.Set(FbxDouble4(ReadRealElement(type, data, 0), ReadRealElement(type, data, 1),
+            ReadRealElement(type, data, 2), ReadRealElement(type, data, 3)));
+    case kPropertyString:
+    case kPropertyUrl:
+        return prop.Set(FbxString(data, value.size));
+    case kPropertyBlob:
+        return prop.Set(FbxBlob(data, static_cast<int>(value.size)));
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,139 @@
+﻿#pragma once
+#include "Hash.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ============================================================================
+// Mesh topology fingerprint
+// ============================================================================
+//
+// Island group IDs are stored per polygon, so they only fit a mesh whose
+// polygons are the same ones they were extracted from. The fingerprint is
+// what the Injector compares before reusing them:
+//
+//   polygonCount        number of polygons
+//   polygonVertexCount  length of the polygon-vertex index stream
+//   sizeBins            polygons with 1, 2, ... 7 and 8+ vertices
+//   indexHash           XXH64 of the index stream (control point indices,
+//                       polygon ends not negated, little-endian int32)
+//
+// Both extraction backends and both injection paths compute it the same
+// way, so an untouched mesh always matches.
+
+const size_t kTopologySizeBins = 8;
+
+struct TopologyFingerprint {
+    uint32_t polygonCount = 0;
+    uint32_t polygonVertexCount = 0;
+    uint32_t sizeBins[kTopologySizeBins] = {};
+    uint64_t indexHash = 0;
+
+    void CountPolygon(int size) {
+        polygonCount++;
+        if (size < 1) size = 1;
+        sizeBins[(size < static_cast<int>(kTopologySizeBins) ? size : kTopologySizeBins) - 1]++;
+    }
+
+    bool operator==(const TopologyFingerprint& other) const {
+        if (polygonCount != other.polygonCount || polygonVertexCount != other.polygonVertexCount ||
+            indexHash != other.indexHash) return false;
+        for (size_t i = 0; i < kTopologySizeBins; i++) {
+            if (sizeBins[i] != other.sizeBins[i]) return false;
+        }
+        return true;
+    }
+    bool operator!=(const TopologyFingerprint& other) const { return !(*this == other); }
+};
+
+inline uint64_t HashPolygonVertices(const int* indices, size_t count) {
+    return Xxh64Hash(indices, count * sizeof(int));
+}
+
+// Fingerprint of an FBX PolygonVertexIndex stream, where the last index of
+// every polygon is stored as ~index, fed in consecutive chunks so the array
+// never has to be decoded whole. Chunks are restored in place before they
+// are hashed.
+//
+// Polygon ends are collected branch-free first and sized in a second loop,
+// so mixed triangle/quad meshes cost the same as uniform ones.
+class FbxTopologyBuilder {
+public:
+    void Add(int* indices, size_t count) {
+        while (count > 0) {
+            size_t n = count < kBatch ? count : kBatch;
+            AddBatch(indices, n);
+            hash.Update(indices, n * sizeof(int));
+            indices += n;
+            count -= n;
+        }
+    }
+
+    // Fails if the last polygon is not terminated.
+    bool Finish(TopologyFingerprint& result) {
+        if (openVertices != 0) return false;
+        result = fingerprint;
+        result.polygonVertexCount = static_cast<uint32_t>(vertexCount);
+        result.indexHash = hash.Digest();
+        return true;
+    }
+
+private:
+    static const size_t kBatch = 4096;
+
+    void AddBatch(int* indices, size_t count) {
+        uint32_t ends[kBatch];
+        size_t endCount = 0;
+        for (size_t i = 0; i < count; i++) {
+            uint32_t end = static_cast<uint32_t>(indices[i]) >> 31;
+            ends[endCount] = static_cast<uint32_t>(i);
+            endCount += end;
+            indices[i] ^= -static_cast<int>(end);
+        }
+
+        int64_t previous = -1 - openVertices;
+        for (size_t i = 0; i < endCount; i++) {
+            int64_t size = ends[i] - previous;
+            previous = ends[i];
+            fingerprint.sizeBins[(size < static_cast<int64_t>(kTopologySizeBins) ? size : kTopologySizeBins) - 1]++;
+        }
+        fingerprint.polygonCount += static_cast<uint32_t>(endCount);
+        openVertices = static_cast<int64_t>(count) - 1 - previous;
+        vertexCount += count;
+    }
+
+    TopologyFingerprint fingerprint;
+    Xxh64 hash;
+    size_t vertexCount = 0;
+    int64_t openVertices = 0;  // vertices of the polygon still open at the end of the last batch
+};
+
+// Counts of an FbxMesh, or anything with the same polygon accessors. The
+// index hash is left to the caller when hashIndices is false, so it can run
+// on another thread.
+template <typename Mesh>
+inline TopologyFingerprint FingerprintMesh(const Mesh* mesh, bool hashIndices = true) {
+    TopologyFingerprint fingerprint;
+    int polygonCount = mesh->GetPolygonCount();
+    for (int i = 0; i < polygonCount; i++) fingerprint.CountPolygon(mesh->GetPolygonSize(i));
+    fingerprint.polygonVertexCount = static_cast<uint32_t>(mesh->GetPolygonVertexCount());
+    if (hashIndices && mesh->GetPolygonVertices()) {
+        fingerprint.indexHash = HashPolygonVertices(mesh->GetPolygonVertices(), fingerprint.polygonVertexCount);
+    }
+    return fingerprint;
+}
+
+// One line for the mismatch report: the first thing that differs.
+inline std::string DescribeTopologyChange(const TopologyFingerprint& cached, const TopologyFingerprint& current) {
+    if (cached.polygonCount != current.polygonCount) {
+        return "polygon count " + std::to_string(cached.polygonCount) + " -> " + std::to_string(current.polygonCount);
+    }
+    if (cached.polygonVertexCount != current.polygonVertexCount) {
+        return "polygon vertex count " + std::to_string(cached.polygonVertexCount) + " -> " +
+            std::to_string(current.polygonVertexCount);
+    }
+    for (size_t i = 0; i < kTopologySizeBins; i++) {
+        if (cached.sizeBins[i] != current.sizeBins[i]) return "polygon sizes changed";
+    }
+    return "vertex indices changed";
+}
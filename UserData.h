@@ -0,0 +1,89 @@
+﻿#pragma once
+#include "PropertyType.h"
+#include <cstdint>
+#include <string>
+
+// ============================================================================
+// Layer user data
+// ============================================================================
+//
+// An FbxLayerElementUserData holds any number of equally long direct
+// arrays, each with a name and a data type, plus one mapping and one
+// reference mode for all of them. A mesh has at most one per layer.
+// Extraction keeps every array of every element whose name marks it as
+// RizomUV data, on every layer; both injection paths rebuild them as they
+// were. Modes are stored as the FbxLayerElement enum values, types as
+// PropertyType tags. Only the scalar types FBX user data can hold are
+// supported; anything else is skipped with a warning.
+
+enum UserDataMapping : uint8_t {
+    kMappingNone = 0,
+    kMappingByControlPoint = 1,
+    kMappingByPolygonVertex = 2,
+    kMappingByPolygon = 3,
+    kMappingByEdge = 4,
+    kMappingAllSame = 5,
+    kMappingCount
+};
+
+enum UserDataReference : uint8_t {
+    kReferenceDirect = 0,
+    kReferenceIndex = 1,
+    kReferenceIndexToDirect = 2,
+    kReferenceCount
+};
+
+// MappingInformationType / ReferenceInformationType as FBX files spell them.
+const char* const kUserDataMappingNames[kMappingCount] = {
+    "NoMappingInformation", "ByVertice", "ByPolygonVertex", "ByPolygon", "ByEdge", "AllSame",
+};
+
+const char* const kUserDataReferenceNames[kReferenceCount] = {
+    "Direct", "Index", "IndexToDirect",
+};
+
+// Unknown names read as no mapping and direct reference.
+inline UserDataMapping UserDataMappingFromFbx(const std::string& name) {
+    if (name == "ByVertex" || name == "ByControlPoint") return kMappingByControlPoint;
+    for (uint8_t i = 0; i < kMappingCount; i++) {
+        if (name == kUserDataMappingNames[i]) return static_cast<UserDataMapping>(i);
+    }
+    return kMappingNone;
+}
+
+inline UserDataReference UserDataReferenceFromFbx(const std::string& name) {
+    for (uint8_t i = 0; i < kReferenceCount; i++) {
+        if (name == kUserDataReferenceNames[i]) return static_cast<UserDataReference>(i);
+    }
+    return kReferenceDirect;
+}
+
+inline const char* UserDataMappingName(uint8_t mapping) {
+    return kUserDataMappingNames[mapping < kMappingCount ? mapping : 0];
+}
+
+inline const char* UserDataReferenceName(uint8_t reference) {
+    return kUserDataReferenceNames[reference < kReferenceCount ? reference : 0];
+}
+
+// FBX array property code of a user data type ('b' 'i' 'f' 'd'), 0 for
+// types user data cannot hold.
+inline char UserDataArrayCode(PropertyType type) {
+    switch (type) {
+    case kPropertyBool: return 'b';
+    case kPropertyInt: return 'i';
+    case kPropertyFloat: return 'f';
+    case kPropertyDouble: return 'd';
+    default: return 0;
+    }
+}
+
+inline bool IsUserDataType(PropertyType type) {
+    return UserDataArrayCode(type) != 0;
+}
+
+// Whether an element with this name is RizomUV data worth keeping.
+inline bool IsRizomUserData(const std::string& name) {
+    return name.find("Island") != std::string::npos || name.find("RizomUV") != std::string::npos ||
+        name.find("GroupID") != std::string::npos;
+}
@@ -8,8 +8,12 @@ PRODUCTION READY
 """
 
 import bpy
+import ctypes
 import os
+import queue
 import subprocess
+import sys
+import threading
 
 # ============================================================================
 # CACHE MANAGER
@@ -79,6 +83,197 @@ class RizomCacheManager:
                     pass
         return count
 
+# ============================================================================
+# BRIDGE DAEMON
+# ============================================================================
+
+class RizomBridgeDaemon:
+    """Long-lived ekstraktor/injektor process started with --serve.
+
+    Keeps the FBX SDK initialised between jobs. Each job is one tab-separated
+    line on stdin, answered by "OK <ms>" or "ERROR <ms> <message>".
+    """
+    
+    _instances = {}
+    
+    def __init__(self, exe_path, options=()):
+        self.exe_path = exe_path
+        self.lines = queue.Queue()
+        self.process = subprocess.Popen(
+            [exe_path] + list(options) + ["--serve"],
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+            text=True,
+            bufsize=1
+        )
+        threading.Thread(target=self._read_stdout, daemon=True).start()
+        
+        ready = self.lines.get(timeout=60)
+        if not ready or not ready.startswith("READY"):
+            self.stop()
+            raise RuntimeError("Bridge daemon did not start")
+        self.init_ms = float(ready.split()[1])
+        print(f"[RizomUV] Daemon {os.path.basename(exe_path)} ready (SDK init {self.init_ms:.0f} ms)")
+    
+    def _read_stdout(self):
+        for line in self.process.stdout:
+            self.lines.put(line.rstrip("\n"))
+        self.lines.put(None)
+    
+    def run(self, args, timeout=60):
+        """Run one job, returns (ok, elapsed_ms, message)"""
+        self.process.stdin.write("\t".join(args) + "\n")
+        self.process.stdin.flush()
+        
+        reply = self.lines.get(timeout=timeout)
+        if reply is None:
+            raise RuntimeError("Bridge daemon exited")
+        
+        status, elapsed, *message = reply.split(" ", 2)
+        return status == "OK", float(elapsed), message[0] if message else ""
+    
+    def stop(self):
+        try:
+            self.process.stdin.write("quit\n")
+            self.process.stdin.flush()
+            self.process.wait(timeout=5)
+        except Exception:
+            self.process.kill()
+    
+    @classmethod
+    def run_job(cls, exe_path, args, options=(), timeout=60):
+        """Run a job on the shared daemon, falling back to a one-shot process.
+
+        options are tool flags (e.g. --threads) applied to every job.
+        Returns (ok, message).
+        """
+        try:
+            daemon = cls._instances.get(exe_path)
+            if daemon is None or daemon.process.poll() is not None:
+                daemon = cls(exe_path, options)
+                cls._instances[exe_path] = daemon
+            ok, elapsed, message = daemon.run(args, timeout)
+            print(f"[RizomUV] {os.path.basename(exe_path)} job: {elapsed:.0f} ms")
+            return ok, message
+        except Exception as e:
+            print(f"[RizomUV] Daemon unavailable ({e}), using one-shot process")
+            daemon = cls._instances.pop(exe_path, None)
+            if daemon:
+                daemon.process.kill()
+        
+        result = subprocess.run(
+            [exe_path] + list(options) + list(args),
+            capture_output=True,
+            text=True,
+            timeout=timeout
+        )
+        return result.returncode == 0, result.stderr
+    
+    @classmethod
+    def stop_all(cls):
+        for daemon in cls._instances.values():
+            daemon.stop()
+        cls._instances.clear()
+
+# ============================================================================
+# BRIDGE LIBRARY
+# ============================================================================
+
+class RizomBridgeBuffer(ctypes.Structure):
+    _fields_ = [
+        ("data", ctypes.c_void_p),
+        ("size", ctypes.c_size_t),
+        ("handle", ctypes.c_void_p),
+    ]
+
+class RizomBridgeLibrary:
+    """In-process bridge: bin/rizombridge.dll (RizomBridge.h) through ctypes.
+
+    Runs the same extraction and injection as the tools without starting a
+    process or parsing its output; caches go in and out as bytes. Optional:
+    if the library is missing or does not load, the daemon and tools are used.
+    """
+    
+    API_VERSION = 1
+    _instance = None
+    _unavailable = False
+    
+    def __init__(self, path):
+        lib = ctypes.CDLL(path)
+        version = lib.rizom_bridge_api_version()
+        if version != self.API_VERSION:
+            raise OSError(f"API version {version}, expected {self.API_VERSION}")
+        
+        options = ctypes.POINTER(ctypes.c_char_p)
+        lib.rizom_bridge_extract.argtypes = [
+            ctypes.c_char_p, options, ctypes.c_int, ctypes.POINTER(RizomBridgeBuffer)
+        ]
+        lib.rizom_bridge_extract.restype = ctypes.c_int
+        lib.rizom_bridge_inject.argtypes = [
+            ctypes.c_char_p, ctypes.c_char_p, ctypes.c_size_t, ctypes.c_char_p, options, ctypes.c_int
+        ]
+        lib.rizom_bridge_inject.restype = ctypes.c_int
+        lib.rizom_bridge_free.argtypes = [ctypes.POINTER(RizomBridgeBuffer)]
+        lib.rizom_bridge_free.restype = None
+        lib.rizom_bridge_last_error.restype = ctypes.c_char_p
+        lib.rizom_bridge_shutdown.restype = None
+        self.lib = lib
+    
+    @classmethod
+    def get(cls):
+        """The loaded library, or None to use the tools"""
+        if cls._instance is None and not cls._unavailable:
+            if sys.platform == "win32":
+                name = "rizombridge.dll"
+            elif sys.platform == "darwin":
+                name = "librizombridge.dylib"
+            else:
+                name = "librizombridge.so"
+            path = os.path.join(os.path.dirname(__file__), "bin", name)
+            try:
+                cls._instance = cls(path)
+                print("[RizomUV] Using the in-process bridge library")
+            except (OSError, AttributeError) as e:
+                cls._unavailable = True
+                if os.path.exists(path):
+                    print(f"[RizomUV] Bridge library unavailable ({e}), using the tools")
+        return cls._instance
+    
+    @staticmethod
+    def _options(options):
+        encoded = [str(option).encode("utf-8") for option in options]
+        return (ctypes.c_char_p * len(encoded))(*encoded), len(encoded)
+    
+    def _error(self):
+        return self.lib.rizom_bridge_last_error().decode("utf-8", "replace")
+    
+    def extract(self, fbx_path, options=()):
+        """Cache bytes of fbx_path, raises RuntimeError on failure"""
+        argv, argc = self._options(options)
+        buffer = RizomBridgeBuffer()
+        if self.lib.rizom_bridge_extract(fbx_path.encode("utf-8"), argv, argc, ctypes.byref(buffer)) != 0:
+            raise RuntimeError(self._error())
+        try:
+            return ctypes.string_at(buffer.data, buffer.size)
+        finally:
+            self.lib.rizom_bridge_free(ctypes.byref(buffer))
+    
+    def inject(self, target_fbx, cache, output_fbx, options=()):
+        """Inject cache bytes into target_fbx, raises RuntimeError on failure"""
+        argv, argc = self._options(options)
+        result = self.lib.rizom_bridge_inject(
+            target_fbx.encode("utf-8"), cache, len(cache), output_fbx.encode("utf-8"), argv, argc
+        )
+        if result != 0:
+            raise RuntimeError(self._error())
+    
+    @classmethod
+    def shutdown(cls):
+        if cls._instance is not None:
+            cls._instance.lib.rizom_bridge_shutdown()
+        cls._instance = None
+
 # ============================================================================
 # IMPORT OPERATOR
 # ============================================================================
@@ -113,20 +308,27 @@ class IMPORT_OT_fbx_rizom(bpy.types.Operator):
         if self.extract_rizom:
             addon_dir = os.path.dirname(__file__)
             extractor_path = os.path.join(addon_dir, "bin", "ekstraktor.exe")
+            options = ["--quiet", "--threads", "0", "--compact-ids", "--remap-data"]
+            library = RizomBridgeLibrary.get()
             
-            if not os.path.exists(extractor_path):
+            if library is None and not os.path.exists(extractor_path):
                 self.report({'ERROR'}, "Extractor not found!")
                 return {'CANCELLED'}
             
             try:
-                result = subprocess.run(
-                    [extractor_path, fbx_path, cache_path],
-                    capture_output=True,
-                    text=True,
-                    timeout=60
-                )
+                if library is not None:
+                    # Written next to the cache and renamed, like the tool does.
+                    cache = library.extract(fbx_path, options)
+                    with open(cache_path + ".tmp", "wb") as f:
+                        f.write(cache)
+                    os.replace(cache_path + ".tmp", cache_path)
+                    ok = True
+                else:
+                    ok, message = RizomBridgeDaemon.run_job(
+                        extractor_path, [fbx_path, cache_path], options=options
+                    )
                 
-                if result.returncode == 0:
+                if ok:
                     self.report({'INFO'}, f"✓ Cache: {os.path.basename(cache_path)}")
                     
             except Exception as e:
@@ -218,7 +420,8 @@ class EXPORT_OT_fbx_rizom_pro(bpy.types.Operator):
         if self.inject_rizom:
             if self.selected_cache and self.selected_cache != "NONE":
                 cache_path = self.selected_cache
-                self._inject(temp_fbx, output_fbx, cache_path)
+                names = self._selected_mesh_names(context) if self.use_selection else None
+                self._inject(temp_fbx, output_fbx, cache_path, names)
             else:
                 self.report({'WARNING'}, "No cache selected.")
                 if os.path.exists(temp_fbx):
@@ -230,25 +433,47 @@ class EXPORT_OT_fbx_rizom_pro(bpy.types.Operator):
         self.report({'INFO'}, "✓ Export completed!")
         return {'FINISHED'}
     
-    def _inject(self, temp_fbx, output_fbx, cache_path):
-        """Inject cache into FBX"""
+    @staticmethod
+    def _selected_mesh_names(context):
+        """Object and mesh data names of the selected meshes"""
+        names = set()
+        for obj in context.selected_objects:
+            if obj.type == 'MESH':
+                names.add(obj.name)
+                names.add(obj.data.name)
+        return sorted(names)
+    
+    def _inject(self, temp_fbx, output_fbx, cache_path, names=None):
+        """Inject cache into FBX, limited to names when given"""
         addon_dir = os.path.dirname(__file__)
         injector_path = os.path.join(addon_dir, "bin", "injektor.exe")
+        library = RizomBridgeLibrary.get()
+        
+        if library is not None:
+            self._inject_in_process(library, temp_fbx, output_fbx, cache_path, names)
+            return
         
         if not os.path.exists(injector_path):
             if os.path.exists(temp_fbx):
                 os.replace(temp_fbx, output_fbx)
             return
         
+        # Only the selected meshes' cache blocks are read. "=" marks a
+        # literal name, so names containing * ? [ are not taken as globs.
+        args = [temp_fbx, cache_path, output_fbx]
+        filter_path = output_fbx + ".filter.txt"
+        if names:
+            with open(filter_path, "w", encoding="utf-8") as f:
+                f.writelines(f"={name}\n" for name in names)
+            args.append(filter_path)
+        
         try:
-            result = subprocess.run(
-                [injector_path, temp_fbx, cache_path, output_fbx],
-                capture_output=True,
-                text=True,
-                timeout=60
+            ok, message = RizomBridgeDaemon.run_job(
+                injector_path, args,
+                options=["--quiet", "--threads", "0"]
             )
             
-            if result.returncode == 0:
+            if ok:
                 if os.path.exists(temp_fbx):
                     os.remove(temp_fbx)
                 self.report({'INFO'}, "✓ RizomUV data injected!")
@@ -256,12 +481,34 @@ class EXPORT_OT_fbx_rizom_pro(bpy.types.Operator):
             else:
                 if os.path.exists(temp_fbx):
                     os.replace(temp_fbx, output_fbx)
-                print(f"[RizomUV] Injection warning: {result.stderr}")
+                print(f"[RizomUV] Injection warning: {message}")
                 
         except Exception as e:
             if os.path.exists(temp_fbx):
                 os.replace(temp_fbx, output_fbx)
             print(f"[RizomUV] Injection error: {str(e)}")
+        finally:
+            if names and os.path.exists(filter_path):
+                os.remove(filter_path)
+    
+    def _inject_in_process(self, library, temp_fbx, output_fbx, cache_path, names=None):
+        """Same as _inject through the bridge library, names passed as options"""
+        options = ["--quiet", "--threads", "0"]
+        for name in names or ():
+            options += ["--include", f"={name}"]
+        
+        try:
+            with open(cache_path, "rb") as f:
+                cache = f.read()
+            library.inject(temp_fbx, cache, output_fbx, options)
+            if os.path.exists(temp_fbx):
+                os.remove(temp_fbx)
+            self.report({'INFO'}, "✓ RizomUV data injected!")
+            print("[RizomUV] Injection successful - Binary FBX created")
+        except Exception as e:
+            if os.path.exists(temp_fbx):
+                os.replace(temp_fbx, output_fbx)
+            print(f"[RizomUV] Injection error: {str(e)}")
     
     def draw(self, context):
         layout = self.layout
@@ -424,6 +671,9 @@ def register():
     print("[RizomUV Bridge PRO] v2.1.2 Registered ✓")
 
 def unregister():
+    RizomBridgeDaemon.stop_all()
+    RizomBridgeLibrary.shutdown()
+    
     for cls in reversed(classes):
         bpy.utils.unregister_class(cls)
     